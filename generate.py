@@ -0,0 +1,86 @@
+"""Emits synthetic C programs for stress and scaling runs of c2z3.
+
+    python3 generate.py --loops 4 --depth 2 --diamonds 8 --phis 3 --assertions 2 -o big.c
+
+The program is a sequence of loop nests. Each nest is --depth loops deep with a
+constant trip count and updates --phis variables in its innermost body, so
+every header gets that many phis. --diamonds if/else diamonds are spread
+between the nests; their arms call different external functions, so the
+normalization cannot fold them into selects. The number of acyclic paths to
+the assertions doubles with every diamond. The --assertions assertions check
+the final values of the variables, which the generator computes, so every
+assertion holds.
+"""
+import argparse
+import sys
+
+
+def generate(loops, depth, diamonds, phis, assertions, trip=4):
+    out = ['#include <stdbool.h>',
+           'extern int unknown(void);',
+           'extern void observe_then(int);',
+           'extern void observe_else(int);',
+           'extern void assert(bool);',
+           '',
+           'int main()',
+           '{']
+    values = [0] * phis
+    for j in range(phis):
+        out.append('\tint v%d = 0;' % j)
+    out.append('\tint t = 0;')
+    # diamond k goes before nest k * loops // diamonds, the rest after the last nest
+    placed = [0] * (loops + 1)
+    for k in range(diamonds):
+        placed[k * loops // diamonds if loops else 0] += 1
+    for l in range(loops + 1):
+        for _ in range(placed[l]):
+            out.append('\tif (unknown() > 0) {')
+            out.append('\t\tt = t + 1;')
+            out.append('\t\tobserve_then(t);')
+            out.append('\t} else {')
+            out.append('\t\tt = t + 2;')
+            out.append('\t\tobserve_else(t);')
+            out.append('\t}')
+        if l == loops:
+            break
+        indent = '\t'
+        for d in range(depth):
+            out.append('%sfor (int i%d_%d = 0; i%d_%d < %d; i%d_%d++) {' % (indent, l, d, l, d, trip, l, d))
+            indent += '\t'
+        for j in range(phis):
+            out.append('%sv%d = v%d + %d;' % (indent, j, j, j + 1))
+            values[j] += (j + 1) * trip ** depth
+        for d in reversed(range(depth)):
+            indent = indent[:-1]
+            out.append('%s}' % indent)
+    for a in range(assertions):
+        if phis == 0 or (diamonds > 0 and a % (phis + 1) == phis):
+            out.append('\tassert(t >= %d);' % diamonds)
+        else:
+            j = a % phis
+            out.append('\tassert(v%d == %d);' % (j, values[j]))
+    out.append('\treturn 0;')
+    out.append('}')
+    return '\n'.join(out) + '\n'
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('--loops', type=int, default=1, help='sequential loop nests')
+    parser.add_argument('--depth', type=int, default=1, help='nesting depth of every loop nest')
+    parser.add_argument('--diamonds', type=int, default=0, help='if/else diamonds between the nests')
+    parser.add_argument('--phis', type=int, default=1, help='variables updated by every nest, i.e. phis per header')
+    parser.add_argument('--assertions', type=int, default=1, help='assertions at the end of main')
+    parser.add_argument('--trip', type=int, default=4, help='trip count of every loop')
+    parser.add_argument('-o', '--output', default='-', help='output file (default: stdout)')
+    args = parser.parse_args()
+    program = generate(args.loops, args.depth, args.diamonds, args.phis, args.assertions, args.trip)
+    if args.output == '-':
+        sys.stdout.write(program)
+    else:
+        with open(args.output, 'w') as f:
+            f.write(program)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,41 @@
+#ifndef BMC_H
+#define BMC_H
+#include "z3++.h"
+
+// Bounded model checking / k-induction over the quantified loop encoding.
+// Every loop axiom `forall n0. body` is instantiated at n0 = -1, 0, ..., k
+// instead of being handed to E-matching, so loops with small trip counts are
+// decided with quantifier-free queries. A counterexample is only reported if
+// the instances define every value it reads. Only single-loop-depth queries
+// (trip count N0) are supported; anything else, including the loops of
+// summarized callees, is reported as unknown.
+// k-induction shows that no state the loop reaches would violate the assertion
+// if the loop exited there. Induction steps get expensive quickly, so they
+// stop at depth max_induction while plain unrolling continues up to max_bound.
+// Each check is limited to timeout ms and the whole unrolling to budget ms
+// (0 for no limit).
+class bmc_engine {
+    private:
+        z3::context& z3ctx;
+        z3::expr_vector ground;
+        z3::expr_vector axioms;
+        // the ground part split into the definitions of the constants after
+        // the loop (after_loop[i] = ..), and the rest, with the exit tests c(N0)
+        z3::expr_vector after_loop;
+        z3::expr_vector definitions;
+        z3::expr_vector conditions;
+        z3::expr_vector exit_tests;
+        z3::expr trip_count;
+        bool supported;
+        unsigned reached;
+        // of the constants after the loop, by violation_at
+        unsigned copies;
+        z3::expr instantiate(const z3::expr& axiom, const z3::expr& n);
+        z3::expr violation_at(const z3::expr& n, z3::expr_vector& values);
+        bool fully_constrained(unsigned k, const z3::expr_vector& instances);
+    public:
+        bmc_engine(const z3::expr_vector& query, z3::context& z3ctx);
+        z3::check_result check(unsigned max_bound, unsigned max_induction, unsigned timeout, unsigned budget);
+        unsigned bound() const;
+};
+#endif
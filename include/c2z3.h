@@ -0,0 +1,33 @@
+#ifndef C2Z3_H
+#define C2Z3_H
+#include <stddef.h>
+#include <z3.h>
+
+/* C interface of libc2z3, for bindings (python/c2z3.py). A module is
+   normalized and summarized once when it is loaded; queries come back as
+   Z3 ASTs in the caller's context, which has to belong to the same libz3
+   that libc2z3 is linked against. The encoder keeps global state, calls
+   must not overlap. */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct c2z3_module c2z3_module;
+
+/* textual IR or bitcode; NULL on error, see c2z3_last_error */
+c2z3_module* c2z3_load(const char* buffer, size_t size);
+void c2z3_free(c2z3_module* m);
+/* the number of assertions in `function`, -1 if there is no such function */
+int c2z3_num_assertions(c2z3_module* m, const char* function);
+/* the negated assertion conjoined with everything it depends on: satisfiable
+   iff the assertion can fail. The caller owns one reference; NULL on error */
+Z3_ast c2z3_query(c2z3_module* m, const char* function, int index, Z3_context ctx);
+/* "Correct", "Wrong" or "Unknown"; NULL on error */
+const char* c2z3_check(c2z3_module* m, const char* function, int index, unsigned timeout_ms);
+/* the message of the last failed call of this thread */
+const char* c2z3_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
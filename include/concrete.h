@@ -0,0 +1,35 @@
+#ifndef CONCRETE_H
+#define CONCRETE_H
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+// Executes a normalized function on concrete inputs to falsify assertions
+// before any symbolic encoding. Parameters and calls to unknown*() get
+// boundary values first, then random ones; calls to assert are intercepted.
+// A run is abandoned (never reported) on anything with undefined or
+// unmodelled behaviour: poison-producing overflow, division by zero,
+// unsupported instructions, or running out of fuel.
+class concrete_executor {
+    private:
+        const llvm::Function& entry;
+        std::mt19937 rng;
+        unsigned run_index;
+        uint64_t fuel;
+        std::vector<std::string> inputs;
+        std::map<const llvm::CallInst*, std::string> violated;
+        int64_t next_input(const std::string& name);
+        bool execute(const llvm::Function& F, const std::vector<llvm::APInt>& args, llvm::APInt& ret, unsigned depth);
+        bool eval(const llvm::Instruction& inst, llvm::DenseMap<const llvm::Value*, llvm::APInt>& frame, llvm::APInt& res, unsigned depth);
+    public:
+        concrete_executor(const llvm::Function& entry, unsigned seed);
+        // assertion call -> inputs of the first run violating it
+        std::map<const llvm::CallInst*, std::string> run(unsigned runs, uint64_t fuel_per_run);
+};
+#endif
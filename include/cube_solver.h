@@ -0,0 +1,28 @@
+#ifndef CUBE_SOLVER_H
+#define CUBE_SOLVER_H
+#include "z3++.h"
+#include <memory>
+#include <vector>
+
+// Cube-and-conquer for queries the solver gave up on. The query is split into
+// cubes that together cover it: the disjuncts of the path condition, each
+// possibly refined by ranges of the trip count. Every thread solves cubes in a
+// context of its own holding a translated copy of the query. The query is sat
+// as soon as one cube is, unsat only if every cube is.
+class cube_solver {
+    private:
+        z3::context& z3ctx;
+        z3::expr_vector query;
+        z3::expr_vector cubes;
+    public:
+        cube_solver(const z3::expr_vector& query, z3::context& z3ctx);
+        // every cube is refined by each top-level disjunct of path_cond
+        void split_paths(const z3::expr& path_cond);
+        // every cube is refined by trip_count < 1, 1 <= trip_count < 2, 2 <= trip_count < 4, ...
+        // up to `ranges` ranges, the last one unbounded
+        void split_trip_count(const z3::expr& trip_count, unsigned ranges);
+        unsigned size() const;
+        // timeout is per cube, in milliseconds
+        z3::check_result check(unsigned threads, unsigned timeout);
+};
+#endif
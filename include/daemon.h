@@ -0,0 +1,40 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+#include "llvm/IR/Module.h"
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+
+// The socket of c2z3 -serve. A client connects, sends one request line and
+// reads reply lines until the daemon closes the connection; requests are
+// handled one at a time, in the order the clients connect.
+class request_server {
+    public:
+        // sends one reply line, false once the client is gone
+        typedef std::function<bool(const std::string&)> reply_fn;
+        // answers one request, false to stop serving
+        typedef std::function<bool(const std::string&, const reply_fn&)> handler_fn;
+        request_server(const std::string& path);
+        ~request_server();
+        bool enabled() const;
+        void serve(const handler_fn& handler);
+    private:
+        std::string path;
+        int fd;
+};
+
+// sends request to the daemon listening at path and passes it the reply lines;
+// false if no daemon is listening there
+bool send_request(const std::string& path, const std::string& request, const std::function<void(const std::string&)>& on_line);
+
+// the hash of the raw IR of every function of mod, by name, and of its globals
+// under the empty name
+std::map<std::string, uint64_t> module_hashes(const llvm::Module& mod);
+// the functions whose assertions need checking again after the module hashed
+// `previous` became the one hashed `now`: the changed ones and their callers,
+// or all of them if the globals changed
+std::set<const llvm::Function*> stale_functions(const std::set<llvm::Function*>& functions, const std::map<std::string, uint64_t>& now, const std::map<std::string, uint64_t>& previous);
+#endif
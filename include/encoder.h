@@ -0,0 +1,63 @@
+#ifndef ENCODER_H
+#define ENCODER_H
+#include "llvm/ADT/SetVector.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Support/CommandLine.h"
+#include "z3++.h"
+#include "rec_solver.h"
+#include "translator.h"
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class summary_store;
+class memory_model;
+
+extern llvm::cl::OptionCategory C2Z3Category;
+
+// raised (after printing the message) for IR the encoder does not support
+struct encoding_error : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+void abortWithInfo(const std::string &s);
+void combine_vec(z3::expr_vector& vec1, const z3::expr_vector& vec2);
+z3::expr quantify(const z3::expr_vector& vars, const z3::expr& body, const z3::expr& trigger, z3::context& z3ctx);
+
+void find_phi_in_header(const llvm::Value* v, const llvm::Loop* loop, const llvm::LoopInfo& LI, std::set<const llvm::PHINode*>& phis);
+expr_map solve_rec(const llvm::Value* v, const llvm::LoopInfo& LI, z3::context& z3ctx);
+
+z3::expr_vector inst2z3(const llvm::Instruction* inst, const llvm::LoopInfo& LI, const llvm::DominatorTree& DT, const llvm::PostDominatorTree& PDT, std::set<const llvm::Loop*>& loops, z3::context& z3ctx);
+z3::expr_vector quantify_at(const llvm::BasicBlock* bb, const z3::expr_vector& res, const z3::expr_vector& triggers, const llvm::LoopInfo& LI, z3::context& z3ctx);
+// the facts v depends on; values already in visited are skipped, the ones
+// encoded are added to it in the order they are reached
+z3::expr_vector rel2z3(const llvm::Value* v, llvm::SetVector<const llvm::Value*>& visited, const llvm::LoopInfo& LI, const llvm::DominatorTree& DT, const llvm::PostDominatorTree& PDT, std::set<const llvm::Loop*>& loops, z3::context& z3ctx);
+// the trip count axioms of loop; the exit conditions they mention are appended to exit_conds
+z3::expr_vector handle_loop(const llvm::Loop* loop, std::vector<const llvm::Value*>& exit_conds, const llvm::LoopInfo& LI, z3::context& z3ctx);
+z3::expr path_condition(const llvm::BasicBlock* bb, const llvm::LoopInfo& LI, z3::context& z3ctx);
+
+// the select phi is encoded as, or phi itself if it is not a two-way phi of a
+// conditional branch
+const llvm::Instruction* phi_as_select(const llvm::PHINode* phi, const llvm::DominatorTree& DT, const llvm::PostDominatorTree& PDT);
+// rewrites the two-way phis of F into the selects rel2z3 encodes them as;
+// rel2z3 does this on demand, but only while no other thread is reading the IR
+void lower_phis(const llvm::Function& F, const llvm::DominatorTree& DT, const llvm::PostDominatorTree& PDT);
+// loads of F read the partitioned memory of `model` (nullptr: loads stay unconstrained)
+void set_memory_model(const llvm::Function& F, const memory_model* model);
+// whether every term is simplified as it is built (the default), rather than once
+// on the assembled query by the solver's preprocessing
+void set_simplification(bool eager);
+// e simplified if terms are simplified as they are built
+z3::expr simplified(const z3::expr& e);
+// drops what the encoder keeps about F (its lowered phis, its memory model),
+// before F is deleted
+void release_function(const llvm::Function& F);
+// calls are constrained by the callee's summary from now on (nullptr: calls stay unconstrained)
+void set_call_summaries(const summary_store* summaries);
+#endif
@@ -0,0 +1,14 @@
+#ifndef FRONTEND_H
+#define FRONTEND_H
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Compiles a C file in-process with clang into ctx, the same IR
+// `clang -emit-llvm -Xclang -disable-O0-optnone` would produce.
+// Diagnostics go to stderr; returns null if compilation fails.
+std::unique_ptr<llvm::Module> compile_c(const std::string& path, const std::vector<std::string>& extra_args, llvm::LLVMContext& ctx);
+#endif
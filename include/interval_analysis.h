@@ -0,0 +1,49 @@
+#ifndef INTERVAL_ANALYSIS_H
+#define INTERVAL_ANALYSIS_H
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+
+#include <cstdint>
+
+// [lo, hi] over the signed range of the value's type, INT64_MIN/INT64_MAX standing for -inf/+inf
+struct interval {
+    int64_t lo;
+    int64_t hi;
+    static interval top();
+    static interval of_type(const llvm::Type* ty);
+    static interval constant(int64_t v);
+    bool is_bottom() const;
+    bool is_constant() const;
+    interval join(const interval& other) const;
+    interval meet(const interval& other) const;
+    interval widen(const interval& next) const;
+    bool operator==(const interval& other) const;
+};
+
+// Interval abstract interpretation over the normalized (LCSSA, loop-simplified)
+// CFG: forward fixpoint in reverse post-order, conditions refine operand ranges
+// on branch edges, loop headers widen after a few visits and a narrowing pass
+// recovers the bounds implied by the exit conditions.
+class interval_analysis {
+    private:
+        typedef llvm::DenseMap<const llvm::Value*, interval> state;
+        const llvm::Function& F;
+        const llvm::LoopInfo& LI;
+        llvm::DenseMap<const llvm::BasicBlock*, state> out;
+        state defs;
+        interval eval(const llvm::Value* v, const state& s) const;
+        interval transfer(const llvm::Instruction& inst, const state& s) const;
+        state edge(const llvm::BasicBlock* from, const llvm::BasicBlock* to) const;
+        void refine(const llvm::Value* cond, bool taken, state& s) const;
+        bool visit(const llvm::BasicBlock* bb, bool widen);
+    public:
+        interval_analysis(const llvm::Function& F, const llvm::LoopInfo& LI);
+        void run(unsigned widen_delay = 2, unsigned narrowing_passes = 2);
+        // range of v at its definition, valid at every point v is live
+        interval range(const llvm::Value* v) const;
+        // the asserted condition holds whenever the assert call is reached
+        bool proves(const llvm::Use& cond) const;
+};
+#endif
@@ -0,0 +1,49 @@
+#ifndef INVARIANTS_H
+#define INVARIANTS_H
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Instructions.h"
+#include "z3++.h"
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <vector>
+
+// constant + sum of coeffs[v] * v
+struct affine {
+    std::map<const llvm::Value*, int64_t> coeffs;
+    int64_t constant = 0;
+};
+
+// Linear invariants c.x + d >= 0 of a top-level loop, over its integer header
+// phis x and the loop-invariant values they start from or are updated with.
+// Templates are solved for c with Farkas' lemma: the invariant holds on entry and
+// an iteration preserves it (given the header's exit test) iff multipliers exist
+// that make the post-state a non-negative combination of the premises, a linear
+// query over c and the multipliers. d is then minimized for the strongest bound.
+// A subterm of an update that is not affine is a fresh input of each iteration,
+// one more variable of the query whose coefficient in the post-state must be 0.
+class invariant_synthesis {
+    private:
+        const llvm::Loop* loop;
+        const llvm::LoopInfo& LI;
+        // header phis first, then loop-invariant values
+        std::vector<const llvm::Value*> vars;
+        std::map<const llvm::Value*, affine> updates;
+        std::map<const llvm::Value*, affine> initial;
+        // the non-affine subterms of the updates
+        std::set<const llvm::Value*> inputs;
+        // premises g >= 0 of an iteration
+        std::vector<affine> guards;
+        // v over vars, false if it is not affine; header phis outside `phis` are not variables.
+        // With `havoc`, values of the loop that are not affine are added to inputs instead
+        bool translate(const llvm::Value* v, const std::set<const llvm::PHINode*>& phis, affine& res, bool havoc = false);
+        void add_guard(const llvm::ICmpInst* cmp, bool taken, const std::set<const llvm::PHINode*>& phis);
+        bool prepare();
+    public:
+        invariant_synthesis(const llvm::Loop* loop, const llvm::LoopInfo& LI);
+        // the invariants, as facts about the state the loop exits in (index N0);
+        // timeout in milliseconds per solver call
+        z3::expr_vector run(z3::context& z3ctx, unsigned max_invariants = 8, unsigned timeout = 200);
+};
+#endif
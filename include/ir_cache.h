@@ -0,0 +1,42 @@
+#ifndef IR_CACHE_H
+#define IR_CACHE_H
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+
+// On-disk cache of normalized modules, one entry per input path.
+// <dir>/<key>.bc holds the normalized module and <dir>/<key>.idx the hash of
+// the input file and the entry functions on its first line, then "<hash> <name>" for each function
+// that went through the pipeline, where <hash> is taken over its raw IR
+// without metadata ids. Only those functions have bodies in the module.
+class ir_cache {
+    private:
+        std::string base;
+        uint64_t content_hash;
+        bool unchanged;
+        // the module came from load_unchanged
+        bool hit;
+        std::map<std::string, uint64_t> normalized;
+        // the functions record()ed in this run
+        std::set<std::string> recorded;
+        std::unique_ptr<llvm::Module> previous;
+        bool reuse_into(llvm::Function& F, llvm::Function& old);
+    public:
+        ir_cache(const std::string& dir, const std::string& input_path, llvm::StringRef contents, const std::set<std::string>& entries);
+        // the normalized module when the input is unchanged since the cache was written;
+        // only for inputs whose module depends on nothing but their contents
+        std::unique_ptr<llvm::Module> load_unchanged(llvm::LLVMContext& ctx);
+        // whether F (in the module from load_unchanged) is already normalized
+        bool is_normalized(const llvm::Function& F) const;
+        // replaces the body of F with its cached normalized body if its raw IR is unchanged
+        bool reuse(llvm::Function& F, uint64_t raw_hash, llvm::LLVMContext& ctx);
+        void record(const llvm::Function& F, uint64_t raw_hash);
+        // writes the normalized functions of mod and their raw hashes
+        void store(const llvm::Module& mod);
+        static uint64_t function_hash(const llvm::Function& F);
+};
+#endif
@@ -0,0 +1,48 @@
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+#include "llvm/Support/raw_ostream.h"
+#include "z3++.h"
+#include <memory>
+#include <vector>
+
+// resident set size of this process in MB, now and the most it has been
+double current_rss_mb();
+double peak_rss_mb();
+// hands the heap freed so far back to the system, so RSS follows what is in use
+void trim_heap();
+// inside a catch block: whether the exception in flight is Z3 running out of
+// memory_max_size, either as a z3::exception or, from calls that do not
+// translate it, as Z3's own out_of_memory_error
+bool z3_out_of_memory();
+
+// The context the queries are built in. A context is shared by `queries`
+// queries (0: by all of them) and then replaced, and replaced at once after Z3
+// ran out of memory in it; what Z3 keeps of past queries goes with it. With a
+// budget, Z3's allocations are capped at budget_mb (memory_max_size).
+class context_pool {
+    private:
+        unsigned queries;
+        unsigned budget_mb;
+        unsigned used;
+        std::unique_ptr<z3::context> ctx;
+    public:
+        // Z3 does not start in less
+        static const unsigned min_budget_mb = 64;
+        context_pool(unsigned queries, unsigned budget_mb = 0);
+        z3::context& acquire();
+        // after a query is done with the context and its terms are gone; true if
+        // the context was dropped
+        bool release(bool exhausted);
+};
+
+// RSS samples taken between assertions: the peak, and the steady state as the
+// median of the later half, past the warm-up of the first functions
+class rss_monitor {
+    private:
+        std::vector<double> samples;
+    public:
+        void sample();
+        double steady_mb() const;
+        void report(llvm::raw_ostream& os) const;
+};
+#endif
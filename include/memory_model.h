@@ -0,0 +1,60 @@
+#ifndef MEMORY_MODEL_H
+#define MEMORY_MODEL_H
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/MemorySSA.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// One state of a memory partition, encoded as an Int -> Int array indexed by
+// byte offsets into the partition's object. Versions defined inside loops are
+// array-valued functions of the loop indices, like the values of the encoding.
+struct memory_version {
+    enum kind_t { initial, stored, merged, havoc };
+    kind_t kind;
+    std::string name;
+    const llvm::BasicBlock* block;              // where the version comes into being
+    const llvm::StoreInst* store;               // stored: the update
+    const memory_version* prev;                 // stored: the state it updates
+    std::vector<std::pair<const llvm::BasicBlock*, const memory_version*>> incoming; // merged: per predecessor
+};
+
+// Memory is partitioned by allocation site: the underlying objects of the
+// accessed pointers, merged whenever alias analysis cannot separate them.
+// A partition is modeled only if all its accesses go through one object with
+// one integer type; loads of other partitions stay unconstrained. The state a
+// load reads is found with MemorySSA, walking past the definitions of other
+// partitions. Everything is computed up front, so that the encoder may read
+// the model from several threads.
+class memory_model {
+    private:
+        std::deque<memory_version> versions;
+        std::map<const llvm::Value*, unsigned> object_id;
+        std::vector<unsigned> parent;
+        std::vector<const llvm::Value*> objects;
+        std::vector<bool> opaque;
+        std::map<const llvm::Instruction*, unsigned> access_object;
+        std::map<std::pair<const llvm::MemoryAccess*, unsigned>, const memory_version*> version_of;
+        std::map<unsigned, const memory_version*> initial_version;
+        std::map<const llvm::Instruction*, const memory_version*> reaching;
+        std::map<const llvm::StoreInst*, const memory_version*> stored;
+        unsigned counter;
+        unsigned node(const llvm::Value* object);
+        unsigned find(unsigned id);
+        void unite(unsigned a, unsigned b);
+        std::string partition_name(unsigned p) const;
+        const memory_version* version(llvm::MemoryAccess* access, unsigned p, llvm::MemorySSA& MSSA);
+    public:
+        memory_model(llvm::Function& F, llvm::MemorySSA& MSSA, llvm::AAResults& AA);
+        // the state a load reads, nullptr if its partition is not modeled
+        const memory_version* load_version(const llvm::LoadInst* load) const;
+        // the state a store creates, nullptr if its partition is not modeled
+        const memory_version* store_version(const llvm::StoreInst* store) const;
+        unsigned num_partitions() const;
+};
+#endif
@@ -0,0 +1,13 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+#include "llvm/IR/Function.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/Use.h"
+#include <vector>
+
+// the conditions passed to the *assert functions called in f
+std::vector<const llvm::Use*> collect_assertions(llvm::Function& f);
+// the passes the encoder expects its input to have gone through
+// (ir_cache keys its entries on this pipeline)
+void normalize(llvm::Function& F, llvm::FunctionAnalysisManager& FAM);
+#endif
@@ -0,0 +1,34 @@
+#ifndef QUERY_LOG_H
+#define QUERY_LOG_H
+#include <string>
+#include <vector>
+
+// one query handed to the solver backend
+struct query_record {
+    std::string function;
+    int assertion = 0;
+    std::string backend;        // solver_backend::name()
+    unsigned timeout_ms = 0;
+    std::string config;         // solver_config::to_string() of the run
+    std::string result;         // sat, unsat or unknown
+    double solve_ms = 0;
+    std::string smt2;
+};
+
+// Append-only log of solver queries, for c2z3-replay. A record is the header line
+//   query <function> <assertion> <backend> <timeout> <result> <solve_ms> <config bytes> <smt2 bytes>
+// (tab-separated) followed by the config and the query text. Each record is
+// appended by one write() under a file lock, forked workers share the log.
+class query_log {
+    private:
+        int fd;
+    public:
+        // an empty path disables the log
+        query_log(const std::string& path);
+        ~query_log();
+        bool enabled() const;
+        void append(const query_record& r);
+        // false (with a message on errs) if the file cannot be read or a record is malformed
+        static bool read(const std::string& path, std::vector<query_record>& records);
+};
+#endif
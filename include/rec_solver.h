@@ -3,19 +3,31 @@
 #include "z3++.h"
 #include <map>
 
+// orders terms by AST id; z3::expr's operator< builds an arithmetic term, which
+// std::less reads as a non-null pointer, so a plain std::map<z3::expr, ...>
+// compares every pair of keys as less than each other
+struct expr_less {
+    bool operator()(const z3::expr& a, const z3::expr& b) const { return a.id() < b.id(); }
+};
+typedef std::map<z3::expr, z3::expr, expr_less> expr_map;
+
+// whether rhs is built from +, -, * and applications of func_decl alone
+bool is_simple_rec(z3::func_decl func_decl, z3::expr rhs);
+// the coefficient of term in the sum e, 0 where it does not occur
+z3::expr coeff_of(z3::expr e, z3::expr term, z3::context& z3ctx);
+
 class rec_solver {
     private:
         z3::context& z3ctx;
-        std::map<z3::expr, z3::expr> rec_eqs;
-        std::map<z3::expr, z3::expr> res;
+        expr_map rec_eqs;
+        expr_map res;
         z3::expr ind_var;
     public:
-        rec_solver(std::map<z3::expr, z3::expr>& rec_eqs, z3::expr var, z3::context& z3ctx);
+        rec_solver(expr_map& rec_eqs, z3::expr var, z3::context& z3ctx);
         rec_solver(z3::context& z3ctx): z3ctx(z3ctx), ind_var(z3ctx) {}
-        void set_eqs(std::map<z3::expr, z3::expr>& rec_eqs);
+        void set_eqs(expr_map& rec_eqs);
         void set_ind_var(z3::expr var);
         void simple_solve();
-        std::map<z3::expr, z3::expr> get_res() const;
-        void expr_solve(z3::expr);
+        expr_map get_res() const;
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,34 @@
+#ifndef RESULT_STREAM_H
+#define RESULT_STREAM_H
+#include <fstream>
+#include <ostream>
+#include <string>
+
+struct assertion_result {
+    std::string verdict;
+    double encode_ms = 0;
+    double solve_ms = 0;
+    unsigned query_size = 0;
+    bool cache_hit = false;
+    // what decided the verdict: "intervals" (discharged before encoding),
+    // "execution" (a concrete run reached the violation) or "solver"
+    std::string decided_by = "solver";
+    // concrete inputs reaching a violation, when one was found by execution
+    std::string witness;
+    // single-line form used to pass results through worker pipes
+    std::string serialize() const;
+    static assertion_result parse(const std::string& line);
+};
+
+// JSON-lines sink, one record per checked assertion, flushed as soon as it is written
+class result_stream {
+    private:
+        std::ofstream file;
+        std::ostream* out;
+    public:
+        // "-" writes to stdout, an empty path disables the stream
+        result_stream(const std::string& path);
+        bool enabled() const;
+        void write(const std::string& function, int index, const std::string& location, const assertion_result& r);
+};
+#endif
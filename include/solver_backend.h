@@ -0,0 +1,66 @@
+#ifndef SOLVER_BACKEND_H
+#define SOLVER_BACKEND_H
+#include "z3++.h"
+#include <sys/types.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// A decision procedure for the queries of check_assertion. The query comes both
+// as the Z3 solver holding it and as its SMT-LIB2 text, a backend uses either.
+// cancel() may be called from another thread while check() runs, check() then
+// returns unknown.
+class solver_backend {
+    public:
+        virtual ~solver_backend() {}
+        virtual std::string name() const = 0;
+        // timeout in milliseconds
+        virtual z3::check_result check(z3::solver& query, const std::string& smt2, unsigned timeout) = 0;
+        virtual void cancel() = 0;
+};
+
+// the query's own solver, through the Z3 API
+class z3_backend : public solver_backend {
+    private:
+        std::mutex lock;
+        z3::context* running;
+        bool cancelled;
+    public:
+        z3_backend();
+        std::string name() const override;
+        z3::check_result check(z3::solver& query, const std::string& smt2, unsigned timeout) override;
+        void cancel() override;
+};
+
+// an external solver, started by `sh -c` for every query. The query is streamed
+// to its stdin, the first line it prints (sat, unsat, ...) is the answer; the
+// process is killed at the timeout.
+class smtlib_backend : public solver_backend {
+    private:
+        std::string command;
+        std::mutex lock;
+        pid_t pid;
+        bool cancelled;
+    public:
+        smtlib_backend(const std::string& command);
+        std::string name() const override;
+        z3::check_result check(z3::solver& query, const std::string& smt2, unsigned timeout) override;
+        void cancel() override;
+};
+
+// the backends side by side, one thread each; the first sat or unsat answer wins
+// and the others are cancelled
+class racing_backend : public solver_backend {
+    private:
+        std::vector<std::unique_ptr<solver_backend>> backends;
+    public:
+        racing_backend(std::vector<std::unique_ptr<solver_backend>> backends);
+        std::string name() const override;
+        z3::check_result check(z3::solver& query, const std::string& smt2, unsigned timeout) override;
+        void cancel() override;
+};
+
+// "z3" for the API, anything else is a solver command line
+std::unique_ptr<solver_backend> make_backend(const std::string& spec);
+#endif
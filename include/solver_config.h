@@ -0,0 +1,32 @@
+#ifndef SOLVER_CONFIG_H
+#define SOLVER_CONFIG_H
+#include "z3++.h"
+#include <istream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A set of Z3 options, stored one `name=value` per line ('#' starts a comment).
+// Names are global Z3 parameters (smt.mbqi, smt.arith.solver, ...), plus
+// c2z3.preprocess, a comma-separated list of tactics run on the query before
+// the SMT core.
+class solver_config {
+    private:
+        std::vector<std::pair<std::string, std::string>> entries;
+    public:
+        static constexpr const char* preprocess_key = "c2z3.preprocess";
+        // false (with a message on errs) if the file cannot be read or a line is malformed
+        bool load(const std::string& path);
+        // the same from a stream, source names it in the messages
+        bool read(std::istream& in, const std::string& source);
+        bool save(const std::string& path) const;
+        void set(const std::string& name, const std::string& value);
+        std::string get(const std::string& name) const;
+        const std::vector<std::pair<std::string, std::string>>& params() const;
+        // sets the global parameters, they apply to the contexts created afterwards
+        void install() const;
+        // a solver for z3ctx, running the preprocessing tactics if there are any
+        z3::solver make_solver(z3::context& z3ctx) const;
+        std::string to_string() const;
+};
+#endif
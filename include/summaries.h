@@ -0,0 +1,39 @@
+#ifndef SUMMARIES_H
+#define SUMMARIES_H
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "z3++.h"
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+// Input/output summaries of the callees: the constraints that tie a function's
+// return value to its parameters, encoded once per function and instantiated at
+// every call site. Summaries are computed bottom-up over the call graph SCCs, so a
+// summary already contains the summaries of the functions it calls.
+class summary_store {
+    private:
+        struct summary {
+            std::vector<std::string> params;    // argument names, in order
+            std::string result;                 // constant standing for the return value
+            z3::expr_vector facts;
+        };
+        z3::context z3ctx;
+        std::map<const llvm::Function*, summary> summaries;
+        mutable std::mutex lock;
+        void summarize(llvm::Function& F);
+    public:
+        // SCCs whose callees are all summarized are handled by up to `threads` threads at once
+        void compute(llvm::Module& mod, llvm::ModuleAnalysisManager& MAM, const std::set<llvm::Function*>& functions, unsigned threads);
+        // the callee's summary for `call` in z3ctx; empty if the callee has none
+        z3::expr_vector instantiate(const llvm::CallInst* call, const llvm::LoopInfo& LI, z3::context& z3ctx) const;
+        // takes over the summary of old, from an earlier version of the module in
+        // previous, for F with the same IR and callees
+        void adopt(const summary_store& previous, const llvm::Function& old, const llvm::Function& F);
+        unsigned size() const;
+};
+#endif
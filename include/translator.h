@@ -0,0 +1,76 @@
+#ifndef TRANSLATOR_H
+#define TRANSLATOR_H
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "z3++.h"
+#include <map>
+#include <optional>
+#include <tuple>
+
+// the loop indices a value's function symbol is applied to
+enum class value_role {
+    def,        // at its definition: x(n0, .., n{d-1} + 1)
+    use,        // from a user in the same iteration, or after its loop
+    from_latch, // from the latch, the iteration before: x(n0, .., n{d-1})
+    exit,       // after its loop exited: x(n0, .., N{d-1})
+    entry,      // on entry to its loop: x(n0, .., 0)
+    in_loop,    // in the body of a loop of depth k, over its indices: x(n0, .., n{k-1})
+    initial,    // the unindexed value the recurrences of a loop start from
+    inlined     // in the body of a loop, with the temporaries of the body substituted
+};
+
+// Translates the values of one function into terms of one context. Every form
+// of a value is built once and shared: terms are memoized per (value, role,
+// loop depth), so the many facts mentioning x(n0 + 1) reuse one AST. Live
+// translators are found by function and context (value_translator::active) for
+// as long as they are in scope, which bounds the memo by the context's lifetime.
+class value_translator {
+    private:
+        typedef std::tuple<const llvm::Value*, value_role, int> key;
+        const llvm::Function* F;
+        z3::context& z3ctx;
+        std::map<key, z3::expr> memo;
+        // v applied to the indices of role, built on the first request
+        z3::expr term(const llvm::Value* v, value_role role, int defDepth, int depth);
+    public:
+        value_translator(const llvm::Function* F, z3::context& z3ctx);
+        ~value_translator();
+        value_translator(const value_translator&) = delete;
+        value_translator& operator=(const value_translator&) = delete;
+        z3::expr def(const llvm::Value* v, const llvm::LoopInfo& LI);
+        z3::expr use(const llvm::Use& u, const llvm::LoopInfo& LI, value_role role = value_role::use);
+        z3::expr entry(const llvm::PHINode* phi, const llvm::LoopInfo& LI);
+        z3::expr in_loop(const llvm::Value* v, const llvm::Loop* loop, bool initial = false);
+        // the recurrence right-hand side of v: operators of the body are expanded
+        // one level over the loop's values, header phis and outside values stay terms
+        z3::expr inlined(const llvm::Value* v, const llvm::Loop* loop);
+        // the innermost translator of F for z3ctx in scope on this thread, if any
+        static value_translator* active(const llvm::Function* F, z3::context& z3ctx);
+};
+
+// the active translator of F, or a translator of its own while there is none
+class translation_scope {
+    private:
+        std::optional<value_translator> own;
+        value_translator* translator;
+    public:
+        translation_scope(const llvm::Function* F, z3::context& z3ctx);
+        value_translator* operator->() { return translator; }
+};
+
+// the term of inst's operator over the terms of its operands, false for the
+// opcodes without one; shared by the facts and the recurrences
+bool operator_term(const llvm::Instruction* inst, const z3::expr_vector& operands, z3::expr& res);
+bool has_operator_term(const llvm::Instruction* inst);
+
+// the function the terms of v belong to (nullptr for constants, globals and
+// instructions outside any block)
+const llvm::Function* function_of(const llvm::Value* v);
+
+z3::expr value2z3(const llvm::Value* v, const llvm::Loop* loop, z3::context& z3ctx, bool initial=false);
+z3::expr eliminate_tmp(const llvm::Value* v, const llvm::Loop* loop, z3::context& z3ctx);
+z3::expr_vector index_args(int defDepth, int userDepth, bool from_latch, bool exit_cond, z3::context& z3ctx);
+z3::expr use2z3(const llvm::Use& u, const llvm::LoopInfo& LI, z3::context &z3ctx, bool from_latch = false, bool exit_cond = false);
+z3::expr def2z3(const llvm::Value* v, const llvm::LoopInfo& LI, z3::context &z3ctx);
+#endif
@@ -0,0 +1,38 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+// A pool of forked worker processes. Each worker runs jobs under an address
+// space cap and a per-job CPU cap and reports a one-line payload per job
+// through a pipe. A job that runs out of memory (std::bad_alloc, or Z3 out of
+// memory) or is killed by a limit (CPU cap, OOM killer) is reported with the
+// payload `resource-out`, one that throws anything else or crashes with
+// `error`. A worker that dies is replaced.
+class worker_pool {
+    public:
+        typedef std::function<std::string(int)> job_fn;
+        typedef std::function<void(int, const std::string&)> result_fn;
+        worker_pool(unsigned size, rlim_t memory_mb, rlim_t cpu_seconds);
+        void run(int num_tasks, const job_fn& job, const result_fn& on_result);
+    private:
+        struct worker {
+            pid_t pid;
+            int task_fd;
+            int result_fd;
+            int task;
+            std::string buffer;
+        };
+        unsigned size;
+        rlim_t memory_mb;
+        rlim_t cpu_seconds;
+        std::vector<worker> workers;
+        bool spawn(worker& w, const job_fn& job);
+        void serve(int task_fd, int result_fd, const job_fn& job);
+        // the wait status of the worker
+        int reap(worker& w);
+};
+#endif
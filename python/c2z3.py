@@ -0,0 +1,106 @@
+"""In-process bindings of c2z3, through the C interface of libc2z3.
+
+    import z3
+    import c2z3
+
+    with c2z3.Module(open('test/test.ll').read()) as m:
+        for i in range(m.num_assertions('main')):
+            print(m.check('main', i), z3.simplify(m.query('main', i)))
+
+Queries are ASTs of the z3 package's own context (z3.main_ctx() unless
+another is given), no SMT2 text is printed or parsed on the way. This only
+works if the z3 package and libc2z3 use the same libz3: point
+Z3_LIBRARY_PATH at the directory of the libz3 c2z3 was built against.
+
+libc2z3.so is looked up in $C2Z3_LIBRARY, next to this file, then in build/.
+"""
+import ctypes
+import os
+
+import z3
+
+
+def _load_library():
+    here = os.path.dirname(os.path.abspath(__file__))
+    candidates = [os.path.join(here, 'libc2z3.so'), os.path.join(here, '..', 'build', 'libc2z3.so')]
+    if 'C2Z3_LIBRARY' in os.environ:
+        candidates.insert(0, os.environ['C2Z3_LIBRARY'])
+    for path in candidates:
+        if os.path.exists(path):
+            return ctypes.CDLL(path)
+    raise OSError('libc2z3.so not found, set C2Z3_LIBRARY')
+
+
+_lib = _load_library()
+_lib.c2z3_load.restype = ctypes.c_void_p
+_lib.c2z3_load.argtypes = [ctypes.c_char_p, ctypes.c_size_t]
+_lib.c2z3_free.restype = None
+_lib.c2z3_free.argtypes = [ctypes.c_void_p]
+_lib.c2z3_num_assertions.restype = ctypes.c_int
+_lib.c2z3_num_assertions.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+_lib.c2z3_query.restype = ctypes.c_void_p
+_lib.c2z3_query.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_int, ctypes.c_void_p]
+_lib.c2z3_check.restype = ctypes.c_char_p
+_lib.c2z3_check.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_int, ctypes.c_uint]
+_lib.c2z3_last_error.restype = ctypes.c_char_p
+_lib.c2z3_last_error.argtypes = []
+
+
+class C2Z3Error(Exception):
+    pass
+
+
+def _error():
+    return C2Z3Error(_lib.c2z3_last_error().decode())
+
+
+class Module:
+    """An LLVM module (textual IR or bitcode), normalized and summarized once."""
+
+    def __init__(self, ir):
+        if isinstance(ir, str):
+            ir = ir.encode()
+        self._handle = _lib.c2z3_load(ir, len(ir))
+        if not self._handle:
+            raise _error()
+
+    def close(self):
+        if self._handle:
+            _lib.c2z3_free(self._handle)
+            self._handle = None
+
+    def __del__(self):
+        self.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def num_assertions(self, function='main'):
+        n = _lib.c2z3_num_assertions(self._handle, function.encode())
+        if n < 0:
+            raise C2Z3Error('no function ' + function)
+        return n
+
+    def query(self, function='main', index=0, ctx=None):
+        """The negated assertion with everything it depends on; sat iff it can fail."""
+        ctx = z3.main_ctx() if ctx is None else ctx
+        ast = _lib.c2z3_query(self._handle, function.encode(), index, ctx.ref())
+        if not ast:
+            raise _error()
+        # the BoolRef takes a reference of its own, the one handed over is dropped
+        res = z3.BoolRef(z3.z3types.Ast(ast), ctx)
+        z3.Z3_dec_ref(ctx.ref(), res.as_ast())
+        return res
+
+    def queries(self, function='main', ctx=None):
+        return [self.query(function, i, ctx) for i in range(self.num_assertions(function))]
+
+    def check(self, function='main', index=0, timeout_ms=3000):
+        """'Correct', 'Wrong' or 'Unknown', as printed by c2z3."""
+        verdict = _lib.c2z3_check(self._handle, function.encode(), index, timeout_ms)
+        if verdict is None:
+            raise _error()
+        return verdict.decode()
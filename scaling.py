@@ -0,0 +1,158 @@
+"""Runs c2z3 over programs from generate.py and plots time and memory per dimension.
+
+    python3 scaling.py --out scaling/
+    python3 scaling.py --sweep diamonds=0,4,8,12,16 --base loops=2 -- -intervals=false
+
+Every dimension (loops, depth, diamonds, phis, assertions) is swept on its own
+while the others keep their --base values (--grid runs the full cross product
+instead). Each point is compiled with clang, checked by c2z3 under a timeout,
+and measured for wall time and peak RSS. Results are appended to
+<out>/scaling.csv, with one line per point. If matplotlib is installed,
+<out>/<dimension>.png plots time and memory against that dimension.
+Arguments after -- are passed to c2z3.
+"""
+import argparse
+import csv
+import itertools
+import os
+import subprocess
+import sys
+import threading
+import time
+
+from generate import generate
+
+DIMENSIONS = ['loops', 'depth', 'diamonds', 'phis', 'assertions']
+BASE = {'loops': 1, 'depth': 1, 'diamonds': 0, 'phis': 1, 'assertions': 1}
+SWEEPS = {
+    'loops': [1, 2, 4, 8, 16, 32],
+    'depth': [1, 2, 3, 4, 5],
+    'diamonds': [0, 2, 4, 6, 8, 10, 12, 14, 16],
+    'phis': [1, 2, 4, 8, 16, 32],
+    'assertions': [1, 2, 4, 8, 16, 32],
+}
+VERDICTS = ('Correct', 'Wrong', 'Unknown')
+
+
+def parse_assignments(items, values):
+    res = {}
+    for item in items:
+        name, _, value = item.partition('=')
+        if name not in DIMENSIONS:
+            sys.exit('unknown dimension %s (one of %s)' % (name, ', '.join(DIMENSIONS)))
+        res[name] = [int(v) for v in value.split(',')] if values else int(value)
+    return res
+
+
+def run_measured(cmd, cwd, timeout):
+    """Wall time in seconds, peak RSS in MB, whether it finished, and stderr."""
+    start = time.monotonic()
+    proc = subprocess.Popen(cmd, cwd=cwd, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+    timer = threading.Timer(timeout, proc.kill)
+    timer.start()
+    stderr = proc.stderr.read().decode(errors='replace')
+    proc.stderr.close()
+    # wait4 reports the resources of this child alone
+    _, status, usage = os.wait4(proc.pid, 0)
+    proc.returncode = os.waitstatus_to_exitcode(status)
+    timer.cancel()
+    elapsed = time.monotonic() - start
+    return elapsed, usage.ru_maxrss / 1024.0, proc.returncode == 0, stderr
+
+
+def points(args, base, sweeps):
+    """(dimension swept, parameters) for every run."""
+    if args.grid:
+        for values in itertools.product(*[sweeps[d] for d in DIMENSIONS]):
+            yield 'grid', dict(zip(DIMENSIONS, values))
+        return
+    for dim in DIMENSIONS:
+        for value in sweeps[dim]:
+            params = dict(base)
+            params[dim] = value
+            yield dim, params
+
+
+def plot(rows, out):
+    try:
+        import matplotlib
+        matplotlib.use('Agg')
+        import matplotlib.pyplot as plt
+    except ImportError:
+        print('matplotlib not installed, see %s' % os.path.join(out, 'scaling.csv'))
+        return
+    for dim in DIMENSIONS:
+        swept = [r for r in rows if r['swept'] == dim]
+        if not swept:
+            continue
+        fig, (time_ax, mem_ax) = plt.subplots(1, 2, figsize=(10, 4))
+        xs = [r[dim] for r in swept]
+        time_ax.plot(xs, [r['seconds'] for r in swept], 'o-')
+        time_ax.set_yscale('log')
+        time_ax.set_xlabel(dim)
+        time_ax.set_ylabel('seconds')
+        for r in swept:
+            if r['status'] != 'ok':
+                time_ax.annotate(r['status'], (r[dim], r['seconds']))
+        mem_ax.plot(xs, [r['max_rss_mb'] for r in swept], 'o-')
+        mem_ax.set_xlabel(dim)
+        mem_ax.set_ylabel('peak RSS (MB)')
+        fig.suptitle('c2z3 against %s' % dim)
+        fig.tight_layout()
+        fig.savefig(os.path.join(out, dim + '.png'))
+        plt.close(fig)
+
+
+def main():
+    argv = sys.argv[1:]
+    extra = []
+    if '--' in argv:
+        extra = argv[argv.index('--') + 1:]
+        argv = argv[:argv.index('--')]
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('--c2z3', default='build/c2z3', help='c2z3 binary')
+    parser.add_argument('--clang', default='clang', help='clang used to compile the programs')
+    parser.add_argument('--out', default='scaling', help='directory of the programs, the CSV and the plots')
+    parser.add_argument('--timeout', type=float, default=120, help='seconds per c2z3 run')
+    parser.add_argument('--trip', type=int, default=4, help='trip count of the generated loops')
+    parser.add_argument('--base', action='append', default=[], metavar='DIM=N', help='value of a dimension while others are swept')
+    parser.add_argument('--sweep', action='append', default=[], metavar='DIM=N,M,..', help='values a dimension is swept over')
+    parser.add_argument('--grid', action='store_true', help='run the cross product of the sweeps')
+    args = parser.parse_args(argv)
+    base = dict(BASE)
+    base.update(parse_assignments(args.base, False))
+    sweeps = dict(SWEEPS)
+    sweeps.update(parse_assignments(args.sweep, True))
+
+    out = os.path.abspath(args.out)
+    c2z3 = os.path.abspath(args.c2z3)
+    # c2z3 writes its queries to tmp/ under the working directory
+    os.makedirs(os.path.join(out, 'tmp'), exist_ok=True)
+    rows = []
+    fields = ['swept'] + DIMENSIONS + ['seconds', 'max_rss_mb', 'status', 'verdicts']
+    with open(os.path.join(out, 'scaling.csv'), 'w', newline='') as f:
+        writer = csv.DictWriter(f, fieldnames=fields)
+        writer.writeheader()
+        for swept, params in points(args, base, sweeps):
+            name = '_'.join('%s%d' % (d, params[d]) for d in DIMENSIONS)
+            source = os.path.join(out, name + '.c')
+            target = os.path.join(out, name + '.ll')
+            with open(source, 'w') as program:
+                program.write(generate(trip=args.trip, **params))
+            cmd = [args.clang, '-emit-llvm', '-S', '-g0', '-Xclang', '-disable-O0-optnone', source, '-o', target]
+            if subprocess.run(cmd).returncode != 0:
+                sys.exit('Fail to convert %s into LLVM IR' % source)
+            seconds, rss, finished, stderr = run_measured([c2z3] + extra + [target], out, args.timeout)
+            verdicts = [line for line in stderr.split('\n') if line in VERDICTS]
+            status = 'ok' if finished else ('timeout' if seconds >= args.timeout else 'failed')
+            row = dict(params, swept=swept, seconds=round(seconds, 3), max_rss_mb=round(rss, 1), status=status,
+                       verdicts=' '.join(verdicts))
+            writer.writerow(row)
+            f.flush()
+            rows.append(row)
+            print('%-48s %8.2fs %8.1fMB %-7s %s' % (name, seconds, rss, status, row['verdicts']))
+    plot(rows, out)
+
+
+if __name__ == '__main__':
+    main()
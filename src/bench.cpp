@@ -0,0 +1,374 @@
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Regex.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "z3++.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "encoder.h"
+#include "rec_solver.h"
+#include "translator.h"
+
+using namespace llvm;
+
+static cl::OptionCategory BenchCategory("c2z3-bench options");
+static cl::opt<std::string> Filter(cl::Positional, cl::desc("[regex of the benchmarks to run]"), cl::init(""), cl::cat(BenchCategory));
+static cl::opt<unsigned> Repetitions("repetitions", cl::desc("Timed samples per benchmark"), cl::init(20), cl::cat(BenchCategory));
+static cl::opt<unsigned> Warmup("warmup", cl::desc("Untimed samples before them"), cl::init(2), cl::cat(BenchCategory));
+static cl::opt<double> MinTime("min-time", cl::desc("Milliseconds a sample runs at least; the iterations per sample are calibrated to it"), cl::init(20), cl::cat(BenchCategory));
+static cl::opt<bool> List("list", cl::desc("List the benchmarks and exit"), cl::init(false), cl::cat(BenchCategory));
+static cl::opt<std::string> CSV("csv", cl::desc("Write the statistics of every benchmark to this CSV file"), cl::init(""), cl::cat(BenchCategory));
+static cl::opt<std::string> Compare("compare", cl::desc("Compare the medians with a CSV file written by -csv"), cl::init(""), cl::cat(BenchCategory));
+
+namespace {
+
+// A benchmark prepares its input once, then runs `iterations` times per sample;
+// only the runs are timed. The value it returns is summed into a sink, so the
+// work cannot be optimized away, and printed as a check that two builds
+// computed the same thing.
+struct benchmark {
+    std::string name;
+    std::function<std::function<unsigned()>()> setup;
+};
+
+struct statistics {
+    double median;
+    // the median absolute deviation from the median, a spread robust to the
+    // outliers of a preempted sample
+    double mad;
+    double min;
+    double max;
+};
+
+// the contexts of the benchmark being run; they outlive its terms, which the
+// run functions hold, and are freed after them
+std::vector<std::unique_ptr<z3::context>> contexts;
+
+z3::context* new_context() {
+    contexts.push_back(std::make_unique<z3::context>());
+    return contexts.back().get();
+}
+
+double median_of(std::vector<double> xs) {
+    std::sort(xs.begin(), xs.end());
+    size_t n = xs.size();
+    return n % 2 ? xs[n / 2] : (xs[n / 2 - 1] + xs[n / 2]) / 2;
+}
+
+statistics statistics_of(const std::vector<double>& samples) {
+    statistics s;
+    s.median = median_of(samples);
+    std::vector<double> deviations;
+    for (double x : samples) {
+        deviations.push_back(std::fabs(x - s.median));
+    }
+    s.mad = median_of(deviations);
+    s.min = *std::min_element(samples.begin(), samples.end());
+    s.max = *std::max_element(samples.begin(), samples.end());
+    return s;
+}
+
+double seconds_of(const std::function<unsigned()>& run, unsigned iterations, unsigned& sink) {
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < iterations; i++) {
+        sink += run();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// doubles the iterations until a sample takes MinTime
+unsigned calibrate(const std::function<unsigned()>& run, unsigned& sink) {
+    unsigned iterations = 1;
+    while (seconds_of(run, iterations, sink) * 1000 < MinTime && iterations < (1u << 30)) {
+        iterations *= 2;
+    }
+    return iterations;
+}
+
+// x + (c1 * x + (y1 + (c2 * x + ...))): n summands, half of them multiples of x
+z3::expr nested_sum(unsigned n, const z3::expr& x, z3::context& z3ctx) {
+    z3::expr e = x;
+    for (unsigned i = 1; i < n; i++) {
+        z3::expr summand = i % 2 ? z3ctx.int_val((int)i) * x : z3ctx.int_const(("y" + std::to_string(i)).data());
+        e = summand + e;
+    }
+    return e;
+}
+
+// f(n) + 2 * (f(n) - y1 + 2 * (f(n) - y2 + ...)): a recurrence right-hand side n operators deep
+z3::expr deep_rhs(unsigned n, const z3::func_decl& f, const z3::expr& ind, z3::context& z3ctx) {
+    z3::expr cur = f(ind);
+    z3::expr e = cur;
+    for (unsigned i = 1; i < n; i++) {
+        z3::expr y = z3ctx.int_const(("y" + std::to_string(i)).data());
+        e = i % 2 ? cur - y + 2 * e : cur + e;
+    }
+    return e;
+}
+
+// n recurrences over induction variable ind, each depending on the one before:
+// f0(n + 1) = f0(n) + 1 and fi(n + 1) = fi(n) + 2 * f{i-1}(n) - f{i-1}(n) - f{i-1}(n) + f0(n) + i,
+// so every closed form is substituted into the next one, where it cancels out and
+// the degrees stay within what simple_solve solves
+expr_map recurrence_system(unsigned n, const z3::expr& ind, z3::context& z3ctx) {
+    expr_map eqs;
+    std::vector<z3::func_decl> fs;
+    for (unsigned i = 0; i < n; i++) {
+        fs.push_back(z3ctx.function(("f" + std::to_string(i)).data(), z3ctx.int_sort(), z3ctx.int_sort()));
+        z3::expr rhs = fs[i](ind) + z3ctx.int_val((int)i + 1);
+        if (i >= 1) rhs = rhs + 2 * fs[i - 1](ind) - fs[i - 1](ind) - fs[i - 1](ind) + fs[0](ind);
+        eqs.insert_or_assign(fs[i](ind + 1), rhs);
+    }
+    return eqs;
+}
+
+// a loop nest `depth` deep around a chain of `length` dependent arithmetic
+// instructions, in the loop-simplify and LCSSA form normalize leaves it in
+std::string loop_nest_ir(unsigned depth, unsigned length) {
+    std::ostringstream ir;
+    ir << "define i32 @nest(i32 %x, i32 %y) {\nentry:\n  br label %h0\n";
+    for (unsigned d = 0; d < depth; d++) {
+        std::string pred = d == 0 ? "entry" : "b" + std::to_string(d - 1);
+        std::string init = d == 0 ? "%x" : "%s" + std::to_string(d - 1);
+        std::string next = d + 1 == depth ? "%t" + std::to_string(length) : "%s" + std::to_string(d + 1) + ".lcssa";
+        ir << "h" << d << ":\n"
+           << "  %i" << d << " = phi i32 [ 0, %" << pred << " ], [ %i" << d << ".next, %l" << d << " ]\n"
+           << "  %s" << d << " = phi i32 [ " << init << ", %" << pred << " ], [ " << next << ", %l" << d << " ]\n"
+           << "  %c" << d << " = icmp slt i32 %i" << d << ", 8\n"
+           << "  br i1 %c" << d << ", label %b" << d << ", label %e" << d << "\n"
+           << "b" << d << ":\n";
+        if (d + 1 < depth) {
+            ir << "  br label %h" << d + 1 << "\n";
+            continue;
+        }
+        ir << "  %t0 = add i32 %s" << d << ", %i" << d << "\n";
+        for (unsigned k = 1; k <= length; k++) {
+            static const char* ops[] = {"add", "mul", "sub", "srem"};
+            std::string rhs = k % 4 == 1 ? "3" : k % 4 == 3 ? "%y" : "%i" + std::to_string(d);
+            ir << "  %t" << k << " = " << ops[k % 4] << " i32 %t" << k - 1 << ", " << rhs << "\n";
+        }
+        ir << "  br label %l" << d << "\n";
+    }
+    for (unsigned d = depth; d-- > 0;) {
+        ir << "e" << d << ":\n  %s" << d << ".lcssa = phi i32 [ %s" << d << ", %h" << d << " ]\n";
+        ir << (d == 0 ? "  ret i32 %s0.lcssa\n" : "  br label %l" + std::to_string(d - 1) + "\n");
+        ir << "l" << d << ":\n  %i" << d << ".next = add i32 %i" << d << ", 1\n  br label %h" << d << "\n";
+    }
+    ir << "}\n";
+    return ir.str();
+}
+
+// the synthetic function and the analyses the encoder reads
+struct ir_input {
+    LLVMContext ctx;
+    std::unique_ptr<Module> mod;
+    Function* F;
+    std::unique_ptr<DominatorTree> DT;
+    std::unique_ptr<PostDominatorTree> PDT;
+    std::unique_ptr<LoopInfo> LI;
+    std::vector<const Instruction*> insts;
+
+    ir_input(unsigned depth, unsigned length) {
+        SMDiagnostic err;
+        mod = parseAssemblyString(loop_nest_ir(depth, length), err, ctx);
+        if (!mod) {
+            err.print("c2z3-bench", errs());
+            exit(1);
+        }
+        F = mod->getFunction("nest");
+        DT = std::make_unique<DominatorTree>(*F);
+        PDT = std::make_unique<PostDominatorTree>(*F);
+        LI = std::make_unique<LoopInfo>(*DT);
+        for (const Instruction& inst : instructions(*F)) {
+            if (!inst.getType()->isVoidTy()) insts.push_back(&inst);
+        }
+    }
+};
+
+std::vector<benchmark> benchmarks() {
+    std::vector<benchmark> res;
+    for (unsigned n : {8, 64, 512}) {
+        res.push_back({"coeff_of/sum" + std::to_string(n), [n]() -> std::function<unsigned()> {
+            z3::context* z3ctx = new_context();
+            z3::expr x = z3ctx->int_const("x");
+            z3::expr e = nested_sum(n, x, *z3ctx);
+            return [=]() { return coeff_of(e, x, *z3ctx).id(); };
+        }});
+    }
+    for (unsigned n : {8, 64, 512}) {
+        res.push_back({"is_simple_rec/depth" + std::to_string(n), [n]() -> std::function<unsigned()> {
+            z3::context* z3ctx = new_context();
+            z3::func_decl f = z3ctx->function("f", z3ctx->int_sort(), z3ctx->int_sort());
+            z3::expr rhs = deep_rhs(n, f, z3ctx->int_const("n"), *z3ctx);
+            return [=]() { return (unsigned)is_simple_rec(f, rhs); };
+        }});
+    }
+    for (unsigned n : {1, 4, 16, 64}) {
+        res.push_back({"simple_solve/system" + std::to_string(n), [n]() -> std::function<unsigned()> {
+            z3::context* z3ctx = new_context();
+            z3::expr ind = z3ctx->int_const("n");
+            expr_map eqs = recurrence_system(n, ind, *z3ctx);
+            // the closed forms found
+            return [=]() mutable {
+                rec_solver s(eqs, ind, *z3ctx);
+                s.simple_solve();
+                return (unsigned)s.get_res().size();
+            };
+        }});
+    }
+    // depth x chain length of the loop nest
+    std::vector<std::pair<unsigned, unsigned>> shapes = {{1, 16}, {1, 256}, {3, 16}, {3, 256}};
+    for (auto shape : shapes) {
+        std::string suffix = "/depth" + std::to_string(shape.first) + "_chain" + std::to_string(shape.second);
+        // every iteration translates the whole function in a fresh translator, the
+        // cost of a cold memo; the terms are kept alive by the context
+        res.push_back({"def2z3" + suffix, [shape]() -> std::function<unsigned()> {
+            auto in = std::make_shared<ir_input>(shape.first, shape.second);
+            z3::context* z3ctx = new_context();
+            return [=]() {
+                translation_scope scope(in->F, *z3ctx);
+                unsigned ids = 0;
+                for (const Instruction* inst : in->insts) {
+                    ids += def2z3(inst, *in->LI, *z3ctx).id();
+                }
+                return ids;
+            };
+        }});
+        res.push_back({"use2z3" + suffix, [shape]() -> std::function<unsigned()> {
+            auto in = std::make_shared<ir_input>(shape.first, shape.second);
+            z3::context* z3ctx = new_context();
+            return [=]() {
+                translation_scope scope(in->F, *z3ctx);
+                unsigned ids = 0;
+                for (const Instruction* inst : in->insts) {
+                    for (const Use& u : inst->operands()) {
+                        if (!isa<BasicBlock>(u.get())) ids += use2z3(u, *in->LI, *z3ctx).id();
+                    }
+                }
+                return ids;
+            };
+        }});
+        res.push_back({"inst2z3" + suffix, [shape]() -> std::function<unsigned()> {
+            auto in = std::make_shared<ir_input>(shape.first, shape.second);
+            z3::context* z3ctx = new_context();
+            return [=]() {
+                translation_scope scope(in->F, *z3ctx);
+                std::set<const Loop*> loops;
+                unsigned facts = 0;
+                for (const Instruction* inst : in->insts) {
+                    facts += inst2z3(inst, *in->LI, *in->DT, *in->PDT, loops, *z3ctx).size();
+                }
+                return facts;
+            };
+        }});
+    }
+    return res;
+}
+
+// name -> median in nanoseconds per iteration, from a CSV written by -csv
+std::map<std::string, double> read_medians(const std::string& path) {
+    std::map<std::string, double> res;
+    std::ifstream in(path);
+    if (!in) {
+        errs() << "c2z3-bench: cannot read " << path << "\n";
+        exit(1);
+    }
+    std::string line;
+    std::getline(in, line);
+    while (std::getline(in, line)) {
+        size_t comma = line.find(',');
+        if (comma == std::string::npos) continue;
+        res[line.substr(0, comma)] = std::stod(line.substr(comma + 1));
+    }
+    return res;
+}
+
+std::string format_ns(double ns) {
+    std::string buf(32, '\0');
+    if (ns >= 1e6) {
+        snprintf(&buf[0], buf.size(), "%.3f ms", ns / 1e6);
+    } else if (ns >= 1e3) {
+        snprintf(&buf[0], buf.size(), "%.3f us", ns / 1e3);
+    } else {
+        snprintf(&buf[0], buf.size(), "%.1f ns", ns);
+    }
+    return buf.c_str();
+}
+
+}
+
+int main(int argc, char** argv) {
+    cl::HideUnrelatedOptions(BenchCategory);
+    cl::ParseCommandLineOptions(argc, argv, "c2z3-bench: time the encoder and recurrence solver on synthetic inputs\n");
+    Regex filter(Filter.empty() ? std::string(".") : Filter.getValue());
+    std::string error;
+    if (!filter.isValid(error)) {
+        errs() << "c2z3-bench: bad filter: " << error << "\n";
+        return 1;
+    }
+    std::map<std::string, double> baseline;
+    if (!Compare.empty()) baseline = read_medians(Compare);
+    std::ofstream csv;
+    if (!CSV.empty()) {
+        csv.open(CSV);
+        csv << "benchmark,median_ns,mad_ns,min_ns,max_ns,iterations,samples,result\n";
+    }
+    for (const benchmark& b : benchmarks()) {
+        if (!filter.match(b.name)) continue;
+        if (List) {
+            outs() << b.name << "\n";
+            continue;
+        }
+        std::function<unsigned()> run = b.setup();
+        unsigned sink = 0;
+        unsigned iterations = calibrate(run, sink);
+        for (unsigned i = 0; i < Warmup; i++) {
+            seconds_of(run, iterations, sink);
+        }
+        std::vector<double> samples;
+        for (unsigned i = 0; i < std::max(1u, (unsigned)Repetitions); i++) {
+            samples.push_back(seconds_of(run, iterations, sink) * 1e9 / iterations);
+        }
+        statistics s = statistics_of(samples);
+        unsigned result = run();
+        std::string line(160, '\0');
+        snprintf(&line[0], line.size(), "%-36s %12s  +-%5.1f%%  min %12s  (%u x %zu)",
+            b.name.c_str(), format_ns(s.median).c_str(), 100 * s.mad / s.median, format_ns(s.min).c_str(), iterations, samples.size());
+        outs() << line.c_str();
+        auto before = baseline.find(b.name);
+        if (before != baseline.end()) {
+            double change = 100 * (s.median - before->second) / before->second;
+            // within three deviations of the new samples, the change is noise
+            bool significant = std::fabs(s.median - before->second) > 3 * s.mad;
+            snprintf(&line[0], line.size(), "  %+6.1f%%%s", change, significant ? "" : " (noise)");
+            outs() << line.c_str();
+        }
+        outs() << "\n";
+        if (csv.is_open()) {
+            csv << b.name << "," << s.median << "," << s.mad << "," << s.min << "," << s.max << ","
+                << iterations << "," << samples.size() << "," << result << "\n";
+        }
+        // the terms go with run, then their contexts
+        run = nullptr;
+        contexts.clear();
+    }
+    return 0;
+}
@@ -0,0 +1,290 @@
+#include "bmc.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// loops of summarized callees have trip counts of their own (N0@call), which the unrolling does not bound
+static bool other_trip_count(const z3::expr& e) {
+    std::set<unsigned> seen;
+    std::vector<z3::expr> todo{e};
+    while (!todo.empty()) {
+        z3::expr cur = todo.back();
+        todo.pop_back();
+        if (!seen.insert(cur.id()).second) continue;
+        if (cur.is_quantifier()) {
+            todo.push_back(cur.body());
+        } else if (cur.is_app()) {
+            if (cur.is_const() && cur.decl().decl_kind() == Z3_OP_UNINTERPRETED) {
+                std::string name = cur.decl().name().str();
+                if (name.size() > 1 && name[0] == 'N' && isdigit(name[1]) && name != "N0") return true;
+            }
+            for (unsigned i = 0; i < cur.num_args(); i++) {
+                todo.push_back(cur.arg(i));
+            }
+        }
+    }
+    return false;
+}
+
+static bool contains(const z3::expr_vector& v, const z3::expr& e) {
+    for (z3::expr x : v) {
+        if (z3::eq(x, e)) return true;
+    }
+    return false;
+}
+
+static bool contains(const z3::expr& e, const z3::expr& sub) {
+    std::set<unsigned> seen;
+    std::vector<z3::expr> todo{e};
+    while (!todo.empty()) {
+        z3::expr cur = todo.back();
+        todo.pop_back();
+        if (z3::eq(cur, sub)) return true;
+        if (!cur.is_app() || !seen.insert(cur.id()).second) continue;
+        for (unsigned i = 0; i < cur.num_args(); i++) {
+            todo.push_back(cur.arg(i));
+        }
+    }
+    return false;
+}
+
+bmc_engine::bmc_engine(const z3::expr_vector& query, z3::context& z3ctx): z3ctx(z3ctx), ground(z3ctx), axioms(z3ctx),
+        after_loop(z3ctx), definitions(z3ctx), conditions(z3ctx), exit_tests(z3ctx), trip_count(z3ctx.int_const("N0")),
+        supported(true), reached(0), copies(0) {
+    for (z3::expr e : query) {
+        if (!e.is_quantifier()) {
+            ground.push_back(e);
+            // the values after the loop, v = rhs
+            z3::expr lhs = e.is_eq() ? e.arg(0) : e;
+            if (e.is_eq() && lhs.is_const() && lhs.decl().decl_kind() == Z3_OP_UNINTERPRETED && !z3::eq(lhs, trip_count)
+                && !contains(after_loop, lhs)) {
+                after_loop.push_back(lhs);
+                definitions.push_back(e);
+                continue;
+            }
+            conditions.push_back(e);
+            // the loop exits at N0: !c(N0)
+            if (e.is_not() && e.arg(0).is_app() && e.arg(0).decl().decl_kind() == Z3_OP_UNINTERPRETED && contains(e.arg(0), trip_count)) {
+                exit_tests.push_back(e.arg(0));
+            }
+        } else if (e.is_forall() && Z3_get_quantifier_num_bound(z3ctx, e) == 1) {
+            axioms.push_back(e);
+        } else {
+            // nested loops quantify over several indices
+            supported = false;
+        }
+        if (other_trip_count(e)) supported = false;
+    }
+}
+
+z3::expr bmc_engine::instantiate(const z3::expr& axiom, const z3::expr& n) {
+    z3::expr_vector dst(z3ctx);
+    dst.push_back(n);
+    return axiom.body().substitute(dst);
+}
+
+// The query as a property of the state after n iterations: the values after
+// the loop computed from that state as if the loop exited there. Their
+// definitions, over fresh copies of the constants, go to values; the result
+// holds if the assertion fails on them. Every exit violating the assertion
+// has this property, so a proof that no reachable state has it covers all
+// exits; the states in the middle of the loop are what k-induction reasons about.
+z3::expr bmc_engine::violation_at(const z3::expr& n, z3::expr_vector& values) {
+    z3::expr_vector src(z3ctx);
+    z3::expr_vector dst(z3ctx);
+    for (z3::expr test : exit_tests) {
+        src.push_back(test);
+        dst.push_back(z3ctx.bool_val(false));
+    }
+    z3::expr_vector exited(z3ctx);
+    for (z3::expr e : conditions) {
+        exited.push_back(e.substitute(src, dst));
+    }
+    src = z3::expr_vector(z3ctx);
+    dst = z3::expr_vector(z3ctx);
+    src.push_back(trip_count);
+    dst.push_back(n);
+    std::string suffix = "!bmc" + std::to_string(copies++);
+    for (z3::expr v : after_loop) {
+        src.push_back(v);
+        dst.push_back(z3ctx.constant((v.decl().name().str() + suffix).data(), v.get_sort()));
+    }
+    for (z3::expr definition : definitions) {
+        values.push_back(definition.substitute(src, dst));
+    }
+    return z3::mk_and(exited).substitute(src, dst);
+}
+
+// whether e is an uninterpreted application f(c0, ..) whose arguments are
+// numerals once simplified, and then its printed form
+static bool numeral_app(const z3::expr& e, std::string& key) {
+    if (!e.is_app() || e.num_args() == 0 || e.decl().decl_kind() != Z3_OP_UNINTERPRETED) return false;
+    z3::expr_vector args(e.ctx());
+    for (unsigned i = 0; i < e.num_args(); i++) {
+        args.push_back(e.arg(i).simplify());
+        if (!args.back().is_numeral()) return false;
+    }
+    key = e.decl()(args).to_string();
+    return true;
+}
+
+static void numeral_apps(const z3::expr& e, std::set<std::string>& apps) {
+    std::set<unsigned> seen;
+    std::vector<z3::expr> todo{e};
+    while (!todo.empty()) {
+        z3::expr cur = todo.back();
+        todo.pop_back();
+        if (!cur.is_app() || !seen.insert(cur.id()).second) continue;
+        std::string key;
+        if (numeral_app(cur, key)) apps.insert(key);
+        for (unsigned i = 0; i < cur.num_args(); i++) {
+            todo.push_back(cur.arg(i));
+        }
+    }
+}
+
+// Whether a model of the query unrolled to `instances` with the loop exiting
+// after k iterations is a run of the program: every application the query
+// reads, through the definitions f(c) = rhs, must be defined by one. An
+// application nothing defines is unconstrained, the model may give it any value.
+bool bmc_engine::fully_constrained(unsigned k, const z3::expr_vector& instances) {
+    z3::expr_vector src(z3ctx);
+    z3::expr_vector dst(z3ctx);
+    src.push_back(trip_count);
+    dst.push_back(z3ctx.int_val(k));
+    std::map<std::string, z3::expr> definitions;
+    std::set<std::string> needed;
+    for (z3::expr e : ground) {
+        e = e.substitute(src, dst);
+        std::string key;
+        // the initial values, f(0) = v
+        if (e.is_eq() && numeral_app(e.arg(0), key)) definitions.emplace(key, e.arg(1));
+        numeral_apps(e, needed);
+    }
+    for (z3::expr body : instances) {
+        body = body.substitute(src, dst);
+        // the values of the loop, (guard =>) f(c) = rhs
+        if (body.is_implies() && body.arg(0).simplify().is_true()) body = body.arg(1);
+        std::string key;
+        if (body.is_eq() && numeral_app(body.arg(0), key)) {
+            definitions.emplace(key, body.arg(1));
+            continue;
+        }
+        // constraints at iterations past the exit hold trivially
+        z3::expr constraint = body.simplify();
+        if (!constraint.is_true()) numeral_apps(constraint, needed);
+    }
+    std::set<std::string> done;
+    std::vector<std::string> todo(needed.begin(), needed.end());
+    while (!todo.empty()) {
+        std::string app = todo.back();
+        todo.pop_back();
+        if (!done.insert(app).second) continue;
+        auto definition = definitions.find(app);
+        if (definition == definitions.end()) return false;
+        std::set<std::string> uses;
+        numeral_apps(definition->second, uses);
+        todo.insert(todo.end(), uses.begin(), uses.end());
+    }
+    return true;
+}
+
+z3::check_result bmc_engine::check(unsigned max_bound, unsigned max_induction, unsigned timeout, unsigned budget) {
+    if (!supported) return z3::unknown;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(budget);
+    // every check gets the query timeout, or what is left of the budget if that is less
+    auto bounded_check = [&](z3::solver& s) {
+        unsigned limit = timeout;
+        if (budget > 0) {
+            long left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            if (left <= 0) return z3::unknown;
+            limit = std::min<long>(limit, left);
+        }
+        z3::params p(z3ctx);
+        p.set(":timeout", limit);
+        s.set(p);
+        return s.check();
+    };
+    z3::solver base(z3ctx);
+    base.add(ground);
+    if (axioms.empty()) return bounded_check(base);
+
+    // k-induction over violation_at: no state of the first k + 1 is violating
+    // (states), and no run has a violating state m + k + 1 after k + 1 that
+    // are not (step)
+    z3::solver states(z3ctx);
+    z3::solver step(z3ctx);
+    z3::expr m = z3ctx.int_const("bmc!m");
+    step.add(m >= 0);
+
+    // values of iteration n are defined at n0 = n - 1 (x(n0 + 1) = ...), so the
+    // instance at -1 gives the first iteration its values
+    z3::expr_vector instances(z3ctx);
+    for (z3::expr axiom : axioms) {
+        instances.push_back(instantiate(axiom, z3ctx.int_val(-1)));
+    }
+    base.add(instances);
+    states.add(instances);
+    for (unsigned k = 0; k <= max_bound; k++) {
+        reached = k;
+        // the exit condition and the values after k iterations are defined at indices <= k
+        for (z3::expr axiom : axioms) {
+            instances.push_back(instantiate(axiom, z3ctx.int_val(k)));
+            base.add(instances.back());
+            states.add(instances.back());
+        }
+        base.push();
+        base.add(trip_count == z3ctx.int_val(k));
+        z3::check_result exit_here = bounded_check(base);
+        base.pop();
+        // a model leaving a value the query reads unconstrained is no counterexample
+        if (exit_here == z3::sat) return fully_constrained(k, instances) ? z3::sat : z3::unknown;
+        if (exit_here == z3::unknown) return z3::unknown;
+
+        // completeness threshold: no violating run iterates more than k times
+        base.push();
+        base.add(trip_count > z3ctx.int_val(k));
+        z3::check_result longer = bounded_check(base);
+        base.pop();
+        if (longer == z3::unsat) return z3::unsat;
+
+        if (k >= max_induction) continue;
+        states.push();
+        z3::expr_vector values(z3ctx);
+        states.add(violation_at(z3ctx.int_val(k), values));
+        states.add(values);
+        states.add(trip_count >= z3ctx.int_val(k));
+        z3::check_result violating = bounded_check(states);
+        states.pop();
+        // the property does not hold of every state, no step can prove it
+        if (violating != z3::unsat) {
+            max_induction = k;
+            continue;
+        }
+        for (z3::expr axiom : axioms) {
+            step.add(instantiate(axiom, m + (int)k));
+        }
+        values = z3::expr_vector(z3ctx);
+        step.add(!violation_at(m + (int)k, values));
+        step.add(values);
+        step.push();
+        values = z3::expr_vector(z3ctx);
+        step.add(violation_at(m + (int)(k + 1), values));
+        step.add(values);
+        step.add(trip_count >= m + (int)(k + 1));
+        z3::check_result inductive = bounded_check(step);
+        step.pop();
+        if (inductive == z3::unsat) return z3::unsat;
+        // deeper steps only get harder, keep unrolling without them
+        if (inductive == z3::unknown) max_induction = k;
+    }
+    return z3::unknown;
+}
+
+unsigned bmc_engine::bound() const {
+    return reached;
+}
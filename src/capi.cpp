@@ -0,0 +1,169 @@
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/MemorySSA.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "z3++.h"
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "c2z3.h"
+#include "encoder.h"
+#include "memory_model.h"
+#include "pipeline.h"
+#include "solver_backend.h"
+#include "summaries.h"
+
+using namespace llvm;
+
+// the analysis managers are declared after the module, so they go first
+struct c2z3_module {
+    LLVMContext ctx;
+    std::unique_ptr<Module> mod;
+    LoopAnalysisManager LAM;
+    FunctionAnalysisManager FAM;
+    CGSCCAnalysisManager CGAM;
+    ModuleAnalysisManager MAM;
+    std::set<Function*> functions;
+    std::map<const Function*, std::unique_ptr<memory_model>> memory_models;
+    std::map<std::string, std::vector<const Use*>> assertions;
+    summary_store summaries;
+    ~c2z3_module() {
+        set_call_summaries(nullptr);
+        for (Function* F : functions) {
+            release_function(*F);
+        }
+    }
+};
+
+static thread_local std::string last_error;
+
+// the assertion, with its function, or nullptr after setting last_error
+static const Use* find_assertion(c2z3_module* m, const char* function, int index, Function*& F) {
+    auto it = m->assertions.find(function);
+    if (it == m->assertions.end()) {
+        last_error = std::string("no function ") + function;
+        return nullptr;
+    }
+    if (index < 0 || index >= (int)it->second.size()) {
+        last_error = std::string(function) + " has no assertion " + std::to_string(index);
+        return nullptr;
+    }
+    F = m->mod->getFunction(function);
+    return it->second[index];
+}
+
+// what check_assertion hands to the solver, without the interval lemmas
+static z3::expr_vector encode(c2z3_module* m, Function& F, const Use* u, z3::context& z3ctx) {
+    // the encoder reads the summaries of the module being encoded
+    set_call_summaries(&m->summaries);
+    LoopInfo& LI = m->FAM.getResult<LoopAnalysis>(F);
+    DominatorTree DT(F);
+    PostDominatorTree PDT(F);
+    translation_scope translator(&F, z3ctx);
+    z3::expr_vector query(z3ctx);
+    query.push_back(!use2z3(*u, LI, z3ctx));
+    SetVector<const Value*> visited;
+    std::set<const Loop*> loops;
+    combine_vec(query, rel2z3(u->get(), visited, LI, DT, PDT, loops, z3ctx));
+    query.push_back(path_condition(cast<Instruction>(u->getUser())->getParent(), LI, z3ctx));
+    return query;
+}
+
+c2z3_module* c2z3_load(const char* buffer, size_t size) {
+    auto m = std::make_unique<c2z3_module>();
+    SMDiagnostic Err;
+    m->mod = parseIR(MemoryBufferRef(StringRef(buffer, size), "<memory>"), Err, m->ctx);
+    if (!m->mod) {
+        raw_string_ostream os(last_error);
+        last_error.clear();
+        Err.print("c2z3", os);
+        os.flush();
+        return nullptr;
+    }
+    PassBuilder PB;
+    PB.registerModuleAnalyses(m->MAM);
+    PB.registerCGSCCAnalyses(m->CGAM);
+    PB.registerFunctionAnalyses(m->FAM);
+    PB.registerLoopAnalyses(m->LAM);
+    PB.crossRegisterProxies(m->LAM, m->FAM, m->CGAM, m->MAM);
+
+    for (Function& F : *m->mod) {
+        if (F.isDeclaration()) continue;
+        normalize(F, m->FAM);
+        m->functions.insert(&F);
+    }
+    for (Function* F : m->functions) {
+        auto model = std::make_unique<memory_model>(*F, m->FAM.getResult<MemorySSAAnalysis>(*F).getMSSA(), m->FAM.getResult<AAManager>(*F));
+        set_memory_model(*F, model.get());
+        m->memory_models.emplace(F, std::move(model));
+        m->assertions.emplace(F->getName().str(), collect_assertions(*F));
+    }
+    set_call_summaries(&m->summaries);
+    m->summaries.compute(*m->mod, m->MAM, m->functions, 0);
+    return m.release();
+}
+
+void c2z3_free(c2z3_module* m) {
+    delete m;
+}
+
+int c2z3_num_assertions(c2z3_module* m, const char* function) {
+    auto it = m->assertions.find(function);
+    return it == m->assertions.end() ? -1 : it->second.size();
+}
+
+Z3_ast c2z3_query(c2z3_module* m, const char* function, int index, Z3_context ctx) {
+    Function* F = nullptr;
+    const Use* u = find_assertion(m, function, index, F);
+    if (!u) return nullptr;
+    try {
+        z3::context z3ctx;
+        z3::expr query = z3::mk_and(encode(m, *F, u, z3ctx));
+        Z3_ast res = Z3_translate(z3ctx, query, ctx);
+        Z3_inc_ref(ctx, res);
+        return res;
+    } catch (const encoding_error& e) {
+        last_error = e.what();
+    } catch (const z3::exception& e) {
+        last_error = e.msg();
+    }
+    return nullptr;
+}
+
+const char* c2z3_check(c2z3_module* m, const char* function, int index, unsigned timeout_ms) {
+    Function* F = nullptr;
+    const Use* u = find_assertion(m, function, index, F);
+    if (!u) return nullptr;
+    try {
+        z3::context z3ctx;
+        z3::solver solver(z3ctx);
+        solver.add(encode(m, *F, u, z3ctx));
+        switch (z3_backend().check(solver, "", timeout_ms)) {
+            case z3::sat: return "Wrong";
+            case z3::unsat: return "Correct";
+            default: return "Unknown";
+        }
+    } catch (const encoding_error& e) {
+        last_error = e.what();
+    } catch (const z3::exception& e) {
+        last_error = e.msg();
+    }
+    return nullptr;
+}
+
+const char* c2z3_last_error(void) {
+    return last_error.c_str();
+}
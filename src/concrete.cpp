@@ -0,0 +1,205 @@
+#include "concrete.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Operator.h"
+
+#include <climits>
+
+using namespace llvm;
+
+static const int64_t boundary_values[] = {0, 1, -1, 2, -2, 10, 100, -100, INT_MAX, INT_MIN};
+static const unsigned num_boundary_values = sizeof(boundary_values) / sizeof(boundary_values[0]);
+static const unsigned max_call_depth = 64;
+
+concrete_executor::concrete_executor(const Function& entry, unsigned seed): entry(entry), rng(seed), run_index(0), fuel(0) {}
+
+// the first runs feed one boundary value everywhere, later runs mix random and boundary values
+int64_t concrete_executor::next_input(const std::string& name) {
+    int64_t v;
+    if (run_index < num_boundary_values) {
+        v = boundary_values[run_index];
+    } else if (rng() % 4 == 0) {
+        v = boundary_values[rng() % num_boundary_values];
+    } else {
+        v = std::uniform_int_distribution<int64_t>(-1000, 1000)(rng);
+    }
+    inputs.push_back(name + "=" + std::to_string(v));
+    return v;
+}
+
+static bool value_of(const Value* v, DenseMap<const Value*, APInt>& frame, APInt& res) {
+    if (auto CI = dyn_cast<ConstantInt>(v)) {
+        res = CI->getValue();
+        return true;
+    }
+    auto it = frame.find(v);
+    if (it == frame.end()) return false;
+    res = it->second;
+    return true;
+}
+
+static APInt input_value(int64_t v, unsigned width) {
+    return APInt(64, (uint64_t)v, true).sextOrTrunc(width);
+}
+
+bool concrete_executor::eval(const Instruction& inst, DenseMap<const Value*, APInt>& frame, APInt& res, unsigned depth) {
+    if (auto BO = dyn_cast<BinaryOperator>(&inst)) {
+        APInt a, b;
+        if (!value_of(BO->getOperand(0), frame, a) || !value_of(BO->getOperand(1), frame, b)) return false;
+        bool nsw = isa<OverflowingBinaryOperator>(BO) && BO->hasNoSignedWrap();
+        bool nuw = isa<OverflowingBinaryOperator>(BO) && BO->hasNoUnsignedWrap();
+        bool s_ov = false, u_ov = false;
+        unsigned width = a.getBitWidth();
+        switch (BO->getOpcode()) {
+            case Instruction::Add: res = a.sadd_ov(b, s_ov); (void)a.uadd_ov(b, u_ov); break;
+            case Instruction::Sub: res = a.ssub_ov(b, s_ov); (void)a.usub_ov(b, u_ov); break;
+            case Instruction::Mul: res = a.smul_ov(b, s_ov); (void)a.umul_ov(b, u_ov); break;
+            case Instruction::SDiv:
+                if (b.isZero() || (a.isMinSignedValue() && b.isAllOnes())) return false;
+                res = a.sdiv(b);
+                break;
+            case Instruction::SRem:
+                if (b.isZero() || (a.isMinSignedValue() && b.isAllOnes())) return false;
+                res = a.srem(b);
+                break;
+            case Instruction::UDiv: if (b.isZero()) return false; res = a.udiv(b); break;
+            case Instruction::URem: if (b.isZero()) return false; res = a.urem(b); break;
+            case Instruction::Shl: if (b.uge(width)) return false; res = a.shl(b); break;
+            case Instruction::LShr: if (b.uge(width)) return false; res = a.lshr(b); break;
+            case Instruction::AShr: if (b.uge(width)) return false; res = a.ashr(b); break;
+            case Instruction::And: res = a & b; break;
+            case Instruction::Or: res = a | b; break;
+            case Instruction::Xor: res = a ^ b; break;
+            default: return false;
+        }
+        // overflow under nsw/nuw yields poison
+        return !(nsw && s_ov) && !(nuw && u_ov);
+    }
+    if (auto CI = dyn_cast<ICmpInst>(&inst)) {
+        APInt a, b;
+        if (!value_of(CI->getOperand(0), frame, a) || !value_of(CI->getOperand(1), frame, b)) return false;
+        res = APInt(1, ICmpInst::compare(a, b, CI->getPredicate()));
+        return true;
+    }
+    if (auto SI = dyn_cast<SelectInst>(&inst)) {
+        APInt c;
+        if (!value_of(SI->getCondition(), frame, c)) return false;
+        return value_of(c.getBoolValue() ? SI->getTrueValue() : SI->getFalseValue(), frame, res);
+    }
+    if (auto CI = dyn_cast<CastInst>(&inst)) {
+        APInt a;
+        if (!value_of(CI->getOperand(0), frame, a) || !CI->getType()->isIntegerTy()) return false;
+        unsigned width = CI->getType()->getIntegerBitWidth();
+        switch (CI->getOpcode()) {
+            case Instruction::ZExt: res = a.zext(width); return true;
+            case Instruction::SExt: res = a.sext(width); return true;
+            case Instruction::Trunc: res = a.trunc(width); return true;
+            default: return false;
+        }
+    }
+    if (auto CI = dyn_cast<CallInst>(&inst)) {
+        const Function* callee = CI->getCalledFunction();
+        if (!callee) return false;
+        if (isa<DbgInfoIntrinsic>(CI)) return true;
+        StringRef name = callee->getName();
+        if (name.endswith("assert")) {
+            APInt cond;
+            if (!value_of(CI->getArgOperand(0), frame, cond)) return false;
+            if (cond.isZero() && !violated.count(CI)) {
+                std::string witness;
+                for (const std::string& in : inputs) {
+                    witness += (witness.empty() ? "" : ",") + in;
+                }
+                violated[CI] = witness;
+            }
+            return true;
+        }
+        if (name.startswith("unknown") && callee->isDeclaration()) {
+            if (!CI->getType()->isIntegerTy()) return false;
+            res = input_value(next_input(name.str() + "()"), CI->getType()->getIntegerBitWidth());
+            return true;
+        }
+        if (callee->isDeclaration()) return false;
+        std::vector<APInt> args;
+        for (const Use& arg : CI->args()) {
+            APInt a;
+            if (!value_of(arg.get(), frame, a)) return false;
+            args.push_back(a);
+        }
+        return execute(*callee, args, res, depth + 1);
+    }
+    return false;
+}
+
+bool concrete_executor::execute(const Function& F, const std::vector<APInt>& args, APInt& ret, unsigned depth) {
+    if (depth > max_call_depth) return false;
+    DenseMap<const Value*, APInt> frame;
+    for (unsigned i = 0; i < F.arg_size(); i++) {
+        frame[F.getArg(i)] = args[i];
+    }
+    const BasicBlock* prev = nullptr;
+    const BasicBlock* bb = &F.getEntryBlock();
+    while (true) {
+        // all phis of a block read the values from before the edge was taken
+        std::vector<std::pair<const PHINode*, APInt>> phi_values;
+        for (const PHINode& phi : bb->phis()) {
+            APInt v;
+            if (!prev || !value_of(phi.getIncomingValueForBlock(prev), frame, v)) return false;
+            phi_values.emplace_back(&phi, v);
+        }
+        for (auto& i : phi_values) {
+            frame[i.first] = i.second;
+        }
+        const BasicBlock* next = nullptr;
+        for (const Instruction& inst : *bb) {
+            if (isa<PHINode>(inst)) continue;
+            if (fuel == 0) return false;
+            fuel--;
+            if (auto br = dyn_cast<BranchInst>(&inst)) {
+                APInt c(1, 1);
+                if (br->isConditional() && !value_of(br->getCondition(), frame, c)) return false;
+                next = br->getSuccessor(c.getBoolValue() ? 0 : 1);
+                break;
+            }
+            if (auto sw = dyn_cast<SwitchInst>(&inst)) {
+                APInt c;
+                if (!value_of(sw->getCondition(), frame, c)) return false;
+                next = sw->getDefaultDest();
+                for (auto& cs : sw->cases()) {
+                    if (cs.getCaseValue()->getValue() == c) next = cs.getCaseSuccessor();
+                }
+                break;
+            }
+            if (auto r = dyn_cast<ReturnInst>(&inst)) {
+                if (r->getReturnValue() && r->getReturnValue()->getType()->isIntegerTy()) {
+                    return value_of(r->getReturnValue(), frame, ret);
+                }
+                return true;
+            }
+            APInt res;
+            if (!eval(inst, frame, res, depth)) return false;
+            if (!inst.getType()->isVoidTy()) frame[&inst] = res;
+        }
+        if (!next) return false;
+        prev = bb;
+        bb = next;
+    }
+}
+
+std::map<const CallInst*, std::string> concrete_executor::run(unsigned runs, uint64_t fuel_per_run) {
+    for (const Argument& arg : entry.args()) {
+        if (!arg.getType()->isIntegerTy()) return violated;
+    }
+    for (run_index = 0; run_index < runs; run_index++) {
+        fuel = fuel_per_run;
+        inputs.clear();
+        std::vector<APInt> args;
+        for (const Argument& arg : entry.args()) {
+            args.push_back(input_value(next_input(arg.getName().str()), arg.getType()->getIntegerBitWidth()));
+        }
+        APInt ret;
+        // violations seen before a run is abandoned are still real
+        execute(entry, args, ret, 0);
+    }
+    return violated;
+}
@@ -0,0 +1,118 @@
+#include "cube_solver.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+cube_solver::cube_solver(const z3::expr_vector& query, z3::context& z3ctx): z3ctx(z3ctx), query(query), cubes(z3ctx) {
+    cubes.push_back(z3ctx.bool_val(true));
+}
+
+void cube_solver::split_paths(const z3::expr& path_cond) {
+    // path_condition nests its disjunctions to the left
+    z3::expr_vector disjuncts(z3ctx);
+    std::vector<z3::expr> todo{path_cond};
+    while (!todo.empty()) {
+        z3::expr cur = todo.back();
+        todo.pop_back();
+        if (cur.is_false()) continue;
+        if (cur.is_or()) {
+            for (unsigned i = cur.num_args(); i > 0; i--) {
+                todo.push_back(cur.arg(i - 1));
+            }
+        } else {
+            disjuncts.push_back(cur);
+        }
+    }
+    if (disjuncts.size() < 2) return;
+    z3::expr_vector refined(z3ctx);
+    for (z3::expr cube : cubes) {
+        for (z3::expr d : disjuncts) {
+            refined.push_back(cube && d);
+        }
+    }
+    cubes = refined;
+}
+
+void cube_solver::split_trip_count(const z3::expr& trip_count, unsigned ranges) {
+    if (ranges < 2) return;
+    z3::expr_vector refined(z3ctx);
+    for (z3::expr cube : cubes) {
+        int lo = 0;
+        for (unsigned i = 0; i < ranges; i++) {
+            int hi = lo == 0 ? 1 : 2 * lo;
+            z3::expr range = z3ctx.bool_val(true);
+            if (i > 0) range = range && trip_count >= lo;
+            if (i + 1 < ranges) range = range && trip_count < hi;
+            refined.push_back((cube && range).simplify());
+            lo = hi;
+        }
+    }
+    cubes = refined;
+}
+
+unsigned cube_solver::size() const {
+    return cubes.size();
+}
+
+z3::check_result cube_solver::check(unsigned threads, unsigned timeout) {
+    threads = std::max(1u, std::min<unsigned>(threads, cubes.size()));
+    // contexts are filled here, the threads only ever touch their own;
+    // declared first, they outlive the solvers and cubes in them
+    std::vector<std::unique_ptr<z3::context>> contexts;
+    std::vector<z3::solver> solvers;
+    std::vector<z3::expr_vector> thread_cubes;
+    for (unsigned t = 0; t < threads; t++) {
+        contexts.push_back(std::make_unique<z3::context>());
+        z3::context& ctx = *contexts.back();
+        z3::solver solver(ctx);
+        z3::params p(ctx);
+        p.set(":timeout", timeout);
+        solver.set(p);
+        for (z3::expr e : query) {
+            solver.add(z3::expr(ctx, Z3_translate(z3ctx, e, ctx)));
+        }
+        z3::expr_vector translated(ctx);
+        for (z3::expr cube : cubes) {
+            translated.push_back(z3::expr(ctx, Z3_translate(z3ctx, cube, ctx)));
+        }
+        solvers.push_back(solver);
+        thread_cubes.push_back(translated);
+    }
+
+    // the main context is not touched by the threads
+    size_t num_cubes = cubes.size();
+    std::atomic<size_t> next(0);
+    std::atomic<bool> found(false);
+    std::atomic<bool> gave_up(false);
+    auto work = [&](unsigned t) {
+        z3::solver& solver = solvers[t];
+        for (size_t i = next++; i < num_cubes && !found; i = next++) {
+            solver.push();
+            solver.add(thread_cubes[t][i]);
+            z3::check_result r = z3::unknown;
+            try {
+                r = solver.check();
+            } catch (const z3::exception&) {
+            }
+            solver.pop();
+            if (r == z3::sat) {
+                // the other cubes no longer matter
+                found = true;
+                for (unsigned other = 0; other < contexts.size(); other++) {
+                    if (other != t) contexts[other]->interrupt();
+                }
+            } else if (r == z3::unknown) {
+                gave_up = true;
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; t++) {
+        pool.emplace_back(work, t);
+    }
+    for (std::thread& t : pool) {
+        t.join();
+    }
+    if (found) return z3::sat;
+    return gave_up ? z3::unknown : z3::unsat;
+}
@@ -0,0 +1,155 @@
+#include "daemon.h"
+#include "ir_cache.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+using namespace llvm;
+
+static bool socket_address(const std::string& path, sockaddr_un& addr) {
+    if (path.size() >= sizeof(addr.sun_path)) {
+        errs() << "c2z3: socket path too long: " << path << "\n";
+        return false;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    return true;
+}
+
+static bool send_line(int fd, const std::string& line) {
+    std::string s = line + "\n";
+    size_t done = 0;
+    while (done < s.size()) {
+        // a client that hung up must not take the daemon down with SIGPIPE
+        ssize_t n = send(fd, s.data() + done, s.size() - done, MSG_NOSIGNAL);
+        if (n < 0) return false;
+        done += n;
+    }
+    return true;
+}
+
+static bool read_line(int fd, std::string& line) {
+    line.clear();
+    char c;
+    while (read(fd, &c, 1) == 1) {
+        if (c == '\n') return true;
+        line.push_back(c);
+    }
+    return !line.empty();
+}
+
+request_server::request_server(const std::string& path): path(path), fd(-1) {
+    sockaddr_un addr;
+    if (!socket_address(path, addr)) return;
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return;
+    // a socket file left behind by a daemon that did not shut down cleanly
+    unlink(path.c_str());
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+        errs() << "c2z3: cannot listen on " << path << ": " << strerror(errno) << "\n";
+        close(fd);
+        fd = -1;
+    }
+}
+
+request_server::~request_server() {
+    if (fd < 0) return;
+    close(fd);
+    unlink(path.c_str());
+}
+
+bool request_server::enabled() const {
+    return fd >= 0;
+}
+
+void request_server::serve(const handler_fn& handler) {
+    bool serving = true;
+    while (serving) {
+        int client = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        std::string request;
+        if (read_line(client, request)) {
+            serving = handler(request, [&](const std::string& line) {
+                return send_line(client, line);
+            });
+        }
+        close(client);
+    }
+}
+
+bool send_request(const std::string& path, const std::string& request, const std::function<void(const std::string&)>& on_line) {
+    sockaddr_un addr;
+    if (!socket_address(path, addr)) return false;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || !send_line(fd, request)) {
+        close(fd);
+        return false;
+    }
+    std::string line;
+    while (read_line(fd, line)) {
+        on_line(line);
+    }
+    close(fd);
+    return true;
+}
+
+std::map<std::string, uint64_t> module_hashes(const Module& mod) {
+    std::map<std::string, uint64_t> hashes;
+    for (const Function& F : mod) {
+        hashes[F.getName().str()] = ir_cache::function_hash(F);
+    }
+    std::string globals;
+    raw_string_ostream os(globals);
+    for (const GlobalVariable& gv : mod.globals()) {
+        gv.print(os);
+        os << "\n";
+    }
+    hashes[""] = xxHash64(os.str());
+    return hashes;
+}
+
+std::set<const Function*> stale_functions(const std::set<Function*>& functions, const std::map<std::string, uint64_t>& now, const std::map<std::string, uint64_t>& previous) {
+    auto changed = [&](const std::string& name) {
+        auto before = previous.find(name);
+        auto after = now.find(name);
+        return before == previous.end() || after == now.end() || before->second != after->second;
+    };
+    std::set<const Function*> stale;
+    bool globals_changed = changed("");
+    // callers of the functions, for the walk up from the changed ones
+    std::map<const Function*, std::vector<const Function*>> callers;
+    std::vector<const Function*> todo;
+    for (Function* F : functions) {
+        for (const Instruction& inst : instructions(*F)) {
+            auto call = dyn_cast<CallBase>(&inst);
+            const Function* callee = call ? call->getCalledFunction() : nullptr;
+            if (!callee) continue;
+            callers[callee].push_back(F);
+            // a declaration is not among the functions, but may have become one
+            if (!functions.count(const_cast<Function*>(callee)) && changed(callee->getName().str())) todo.push_back(F);
+        }
+        if (globals_changed || changed(F->getName().str())) todo.push_back(F);
+    }
+    while (!todo.empty()) {
+        const Function* F = todo.back();
+        todo.pop_back();
+        if (!stale.insert(F).second) continue;
+        for (const Function* caller : callers[F]) {
+            todo.push_back(caller);
+        }
+    }
+    return stale;
+}
@@ -0,0 +1,660 @@
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "z3++.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+#include "encoder.h"
+#include "invariants.h"
+#include "rec_solver.h"
+#include "summaries.h"
+#include "memory_model.h"
+
+using namespace llvm;
+
+cl::OptionCategory C2Z3Category("c2z3 options");
+static cl::opt<bool> QuantifierPatterns("quantifier-patterns", cl::desc("Attach E-matching patterns to the loop axioms"), cl::init(true), cl::cat(C2Z3Category));
+static cl::opt<bool> Invariants("invariants", cl::desc("Add linear invariants found by template solving for loops without closed forms"), cl::init(true), cl::cat(C2Z3Category));
+static cl::opt<bool> BoundedQuantifiers("bounded-quantifiers", cl::desc("Guard the loop axioms with 0 <= n < N"), cl::init(false), cl::cat(C2Z3Category));
+
+bool eager_simplification = true;
+
+void set_simplification(bool eager) {
+    eager_simplification = eager;
+}
+
+// terms are simplified as they are built, unless the query is preprocessed as a whole
+z3::expr simplified(const z3::expr& e) {
+    return eager_simplification ? e.simplify() : e;
+}
+
+std::pair<z3::expr_vector, z3::expr_vector> map2expr_vector(const expr_map& m, z3::context& z3ctx) {
+    z3::expr_vector keys(z3ctx);
+    z3::expr_vector values(z3ctx);
+    for (auto& i : m) {
+        keys.push_back(i.first);
+        values.push_back(i.second);
+    }
+    return std::make_pair(keys, values);
+}
+
+void abortWithInfo(const std::string &s) {
+    errs() << s << "\n";
+    throw encoding_error(s);
+}
+
+void combine_vec(z3::expr_vector& vec1, const z3::expr_vector& vec2) {
+    for (z3::expr e : vec2) {
+        vec1.push_back(e);
+    }
+}
+
+// a pattern is only legal if it mentions every bound variable
+bool covers_vars(const z3::expr& trigger, const z3::expr_vector& vars) {
+    std::set<unsigned> seen;
+    std::vector<z3::expr> todo{trigger};
+    while (!todo.empty()) {
+        z3::expr e = todo.back();
+        todo.pop_back();
+        if (!e.is_app() || !seen.insert(e.id()).second) continue;
+        for (unsigned i = 0; i < e.num_args(); i++) {
+            todo.push_back(e.arg(i));
+        }
+    }
+    for (z3::expr v : vars) {
+        if (seen.find(v.id()) == seen.end()) return false;
+    }
+    return true;
+}
+
+// forall vars. body, triggered on `trigger` (usually the defining application such as x(n0 + 1))
+z3::expr quantify(const z3::expr_vector& vars, const z3::expr& body, const z3::expr& trigger, z3::context& z3ctx) {
+    if (!QuantifierPatterns || !covers_vars(trigger, vars)) {
+        return z3::forall(vars, body);
+    }
+    std::vector<Z3_app> bound;
+    for (z3::expr v : vars) {
+        bound.push_back(v);
+    }
+    Z3_ast t = trigger;
+    Z3_pattern pattern = Z3_mk_pattern(z3ctx, 1, &t);
+    Z3_ast q = Z3_mk_forall_const(z3ctx, 0, bound.size(), bound.data(), 1, &pattern, body);
+    z3ctx.check_error();
+    return z3::expr(z3ctx, q);
+}
+
+z3::expr get_initial_value(const PHINode* phi, const Loop* loop, z3::context& z3ctx) {
+    assert(phi->getNumIncomingValues() == 2);
+    for (int i = 0; i < phi->getNumIncomingValues(); i++) {
+        const BasicBlock* cur_bb = phi->getIncomingBlock(i);
+        if (!loop->contains(cur_bb)) {
+            const Value* incoming_v = phi->getIncomingValue(i);
+            return value2z3(incoming_v, loop, z3ctx, true);
+        }
+    }
+    abortWithInfo("no initial value");
+    return z3ctx.int_val(0);
+}
+
+const Value* get_rec_value(const PHINode* phi, const Loop* loop, z3::context& z3ctx) {
+    assert(phi->getNumIncomingValues() == 2);
+    for (int i = 0; i < phi->getNumIncomingValues(); i++) {
+        const BasicBlock* cur_bb = phi->getIncomingBlock(i);
+        if (loop->contains(cur_bb) && loop->isLoopLatch(cur_bb)) {
+            const Value* incoming_v = phi->getIncomingValue(i);
+            return incoming_v;
+        }
+    }
+    abortWithInfo("no recursive value");
+    return nullptr;
+}
+
+void loop_se(const Loop* loop, const LoopInfo& LI, std::map<const Value*, z3::expr>& rec, std::map<const Value*, z3::expr>& initial, z3::context& z3ctx) {
+    const BasicBlock* header = loop->getHeader();
+    for (auto& phi : header->phis()) {
+        initial.insert_or_assign(&phi, get_initial_value(&phi, loop, z3ctx));
+        // initial[&phi] = get_initial_value(&phi, loop, z3ctx);
+        const Value* rec_value = get_rec_value(&phi, loop, z3ctx);
+        z3::expr tmp2expr = eliminate_tmp(rec_value, loop, z3ctx);
+        rec.insert_or_assign(&phi, tmp2expr);
+        // rec[&phi] = tmp2expr;
+    }
+}
+
+void find_phi_in_header(const Value* v, const Loop* loop, const LoopInfo& LI, std::set<const PHINode*>& phis) {
+    const BasicBlock* header = loop->getHeader();
+    SmallPtrSet<const Instruction*, 16> seen;
+    SmallVector<const Value*, 16> todo;
+    todo.push_back(v);
+    while (!todo.empty()) {
+        const Instruction* ins = dyn_cast<Instruction>(todo.pop_back_val());
+        if (!ins || !seen.insert(ins).second) continue;
+        const BasicBlock* cur_bb = ins->getParent();
+        if (LI.getLoopFor(cur_bb) != loop) continue;
+        if (cur_bb == header && isa<PHINode>(ins)) {
+            phis.insert(dyn_cast<PHINode>(ins));
+        } else {
+            for (auto& operand : ins->operands()) {
+                todo.push_back(operand.get());
+            }
+        }
+    }
+}
+
+expr_map solve_rec(const Value* v, const LoopInfo& LI, z3::context& z3ctx) {
+    expr_map res;
+    const Instruction* ins = dyn_cast<Instruction>(v);
+    Loop* loop = LI.getLoopFor(ins->getParent());
+    if (!loop) return res;
+    std::map<const Value*, z3::expr> initial;
+    std::map<const Value*, z3::expr> rec;
+    loop_se(loop, LI, rec, initial, z3ctx);
+    std::set<const PHINode*> phis;
+    find_phi_in_header(v, loop, LI, phis);
+    std::string ind_var_name = "n" + std::to_string(loop->getLoopDepth() - 1);
+    z3::expr last_ind_var = z3ctx.int_const(ind_var_name.data());
+    expr_map rec_eqs;
+    for (auto& i : rec) {
+        rec_eqs.insert_or_assign(def2z3(i.first, LI, z3ctx), i.second);
+    }
+    rec_solver rec_s(rec_eqs, last_ind_var, z3ctx);
+    // z3::expr v2expr = eliminate_tmp(v, loop, z3ctx);
+    // errs() << v2expr.to_string() << "\n";
+    // errs() << "********************\n";
+    rec_s.simple_solve();
+    res = rec_s.get_res();
+    return res;
+}
+
+z3::expr_vector inst2z3(const Instruction* inst, const LoopInfo& LI, const DominatorTree& DT, const PostDominatorTree& PDT, std::set<const Loop*>& loops, z3::context& z3ctx) {
+    auto opcode = inst->getOpcode();
+    z3::expr_vector res(z3ctx);
+    z3::expr_vector triggers(z3ctx);
+    translation_scope translator(function_of(inst), z3ctx);
+    if (opcode == Instruction::PHI) {
+        assert(inst->getType()->isIntegerTy() || inst->getType()->isPointerTy());
+        const PHINode* PN = dyn_cast<PHINode>(inst);
+        int depth = LI.getLoopDepth(inst->getParent());
+        for (int i = 0; i < PN->getNumIncomingValues(); i++) {
+            const BasicBlock* incoming_b = PN->getIncomingBlock(i);
+            const Loop* someLoop = LI.getLoopFor(incoming_b);
+            // initial values define the first iteration, inductive values the next one
+            bool initial = depth > LI.getLoopDepth(incoming_b);
+            bool from_latch = !initial && depth == LI.getLoopDepth(incoming_b) && someLoop && someLoop->isLoopLatch(incoming_b);
+            z3::expr lhs = initial ? translator->entry(PN, LI) : translator->def(PN, LI);
+            z3::expr rhs = translator->use(PN->getOperandUse(i), LI, from_latch ? value_role::from_latch : value_role::use);
+            res.push_back(simplified(lhs == rhs));
+            triggers.push_back(lhs);
+        }
+        return quantify_at(inst->getParent(), res, triggers, LI, z3ctx);
+    }
+    // addresses of different objects are not comparable, and only pointer casts keep the value
+    if (opcode == Instruction::ICmp && inst->getOperand(0)->getType()->isPointerTy()) return res;
+    if (opcode == Instruction::BitCast && !inst->getType()->isPointerTy()) return res;
+    if (!has_operator_term(inst)) return res;
+    z3::expr_vector operands(z3ctx);
+    for (const Use& u : inst->operands()) {
+        operands.push_back(translator->use(u, LI));
+    }
+    z3::expr rhs(z3ctx);
+    operator_term(inst, operands, rhs);
+    z3::expr lhs = translator->def(inst, LI);
+    res.push_back(simplified(lhs == rhs));
+    triggers.push_back(lhs);
+    return quantify_at(inst->getParent(), res, triggers, LI, z3ctx);
+}
+
+// constraints of block bb hold for every iteration of the loops around it
+z3::expr_vector quantify_at(const BasicBlock* bb, const z3::expr_vector& res, const z3::expr_vector& triggers, const LoopInfo& LI, z3::context& z3ctx) {
+    z3::expr_vector globally_quantified(z3ctx);
+    int depth = LI.getLoopDepth(bb);
+    z3::expr_vector ret(z3ctx);
+    z3::expr bounds = z3ctx.bool_val(true);
+    for (int i = 0; i < depth; i++) {
+        std::string name = std::string("n") + std::to_string(i);
+        z3::expr n = z3ctx.int_const(name.data());
+        globally_quantified.push_back(n);
+        bounds = bounds && n >= 0;
+    }
+    if (depth > 0) {
+        std::string N_name = std::string("N") + std::to_string(depth - 1);
+        bounds = bounds && globally_quantified.back() < z3ctx.int_const(N_name.data());
+    }
+    for (int i = 0; i < res.size(); i++) {
+        if (depth > 0) {
+            z3::expr body = BoundedQuantifiers ? z3::implies(bounds, res[i]) : res[i];
+            ret.push_back(simplified(quantify(globally_quantified, body, simplified(triggers[i]), z3ctx)));
+            // loops.insert(loop);
+        } else {
+            ret.push_back(simplified(res[i]));
+        }
+    }
+    return ret;
+}
+
+
+
+// the select a two-way phi is encoded as, created once per phi
+std::map<const PHINode*, const Instruction*> lowered_phis;
+const summary_store* call_summaries = nullptr;
+
+void set_call_summaries(const summary_store* summaries) {
+    call_summaries = summaries;
+}
+
+// the conditional branch that decides whether curB is entered from bb0 or bb1
+const BranchInst* deciding_branch(const BasicBlock* curB, const BasicBlock* bb0, const BasicBlock* bb1, const DominatorTree& DT, const PostDominatorTree& PDT, bool& bb0_on_true) {
+    const BasicBlock* domB = DT.findNearestCommonDominator(bb0, bb1);
+    if (!PDT.dominates(curB, domB)) return nullptr;
+    const BranchInst* branch = dyn_cast<BranchInst>(domB->getTerminator());
+    if (!branch || !branch->isConditional()) return nullptr;
+    bb0_on_true = DT.dominates(branch->getSuccessor(0), bb0) || DT.dominates(branch->getSuccessor(1), bb1);
+    return branch;
+}
+
+const Instruction* phi_as_select(const PHINode* phi, const DominatorTree& DT, const PostDominatorTree& PDT) {
+    auto lowered = lowered_phis.find(phi);
+    if (lowered != lowered_phis.end()) return lowered->second;
+    const Instruction* inst = phi;
+    bool first_on_true = true;
+    const BranchInst* branch = phi->getNumIncomingValues() == 2 ? deciding_branch(phi->getParent(), phi->getIncomingBlock(0), phi->getIncomingBlock(1), DT, PDT, first_on_true) : nullptr;
+    if (branch) {
+        IRBuilder<> builder(phi->getContext());
+        int true_idx = first_on_true ? 0 : 1;
+        Value* new_select = builder.CreateSelect(branch->getCondition(), phi->getIncomingValue(true_idx), phi->getIncomingValue(1 - true_idx));
+        if (auto select = dyn_cast<Instruction>(new_select)) {
+            select->setName(phi->getName());
+            inst = select;
+        }
+    }
+    lowered_phis.emplace(phi, inst);
+    return inst;
+}
+
+void lower_phis(const Function& F, const DominatorTree& DT, const PostDominatorTree& PDT) {
+    for (const BasicBlock& bb : F) {
+        for (const PHINode& phi : bb.phis()) {
+            phi_as_select(&phi, DT, PDT);
+        }
+    }
+}
+
+std::map<const Function*, const memory_model*> memory_models;
+
+void set_memory_model(const Function& F, const memory_model* model) {
+    memory_models[&F] = model;
+}
+
+void release_function(const Function& F) {
+    for (auto it = lowered_phis.begin(); it != lowered_phis.end();) {
+        if (it->first->getFunction() != &F) {
+            it++;
+            continue;
+        }
+        // the selects were never inserted into a block, nothing else frees them
+        if (it->second != it->first) const_cast<Instruction*>(it->second)->deleteValue();
+        it = lowered_phis.erase(it);
+    }
+    memory_models.erase(&F);
+}
+
+// the array state m, seen from a user in userBB
+z3::expr version_ref(const memory_version* m, const BasicBlock* userBB, bool from_latch, const LoopInfo& LI, z3::context& z3ctx) {
+    int defDepth = LI.getLoopDepth(m->block);
+    z3::sort_vector sorts(z3ctx);
+    for (int i = 0; i < defDepth; i++) {
+        sorts.push_back(z3ctx.int_sort());
+    }
+    z3::func_decl func_sig = z3ctx.function(m->name.data(), sorts, z3ctx.array_sort(z3ctx.int_sort(), z3ctx.int_sort()));
+    return func_sig(index_args(defDepth, LI.getLoopDepth(userBB), from_latch, false, z3ctx));
+}
+
+namespace {
+
+// one node of the encoding still to be visited: a value, a memory state, or
+// facts that are already encoded and only wait for their place in the result
+struct work_item {
+    const Value* value;
+    const memory_version* version;
+    z3::expr_vector facts;
+};
+
+struct encoding_state {
+    SetVector<const Value*>& visited;
+    std::set<const memory_version*> versions;
+    // loops whose invariants have been synthesized
+    std::set<const Loop*> invariant_loops;
+    // loops whose closed forms have been emitted, with the forms
+    std::map<const Loop*, expr_map> closed_forms;
+    const LoopInfo& LI;
+    const DominatorTree& DT;
+    const PostDominatorTree& PDT;
+    std::set<const Loop*>& loops;
+    z3::context& z3ctx;
+    // the items of the node being expanded, in the order their facts are emitted
+    std::vector<work_item> next;
+
+    void value(const Value* v) { next.push_back(work_item{v, nullptr, z3::expr_vector(z3ctx)}); }
+    void version(const memory_version* m) { next.push_back(work_item{nullptr, m, z3::expr_vector(z3ctx)}); }
+    void facts(const z3::expr_vector& f) { if (!f.empty()) next.push_back(work_item{nullptr, nullptr, f}); }
+};
+
+// every integer header phi of loop has a closed form
+bool solves_header(const Loop* loop, const expr_map& closed_form, z3::context& z3ctx) {
+    for (const PHINode& phi : loop->getHeader()->phis()) {
+        if (!phi.getType()->isIntegerTy() || phi.getType()->isIntegerTy(1)) continue;
+        if (!closed_form.count(value2z3(&phi, loop, z3ctx))) return false;
+    }
+    return true;
+}
+
+// the exit conditions and trip count axioms of loop, the first time it is reached
+void expand_loop(const Loop* loop, encoding_state& s) {
+    if (!loop || !s.loops.insert(loop).second) return;
+    std::vector<const Value*> exit_conds;
+    z3::expr_vector axioms = handle_loop(loop, exit_conds, s.LI, s.z3ctx);
+    for (const Value* cond : exit_conds) {
+        s.value(cond);
+    }
+    s.facts(axioms);
+}
+
+// the closed forms of the header phis of the loop around inst; solved and
+// emitted the first time one of its values is reached
+const expr_map& expand_closed_forms(const Loop* loop, const Instruction* inst, encoding_state& s) {
+    auto known = s.closed_forms.find(loop);
+    if (known != s.closed_forms.end()) return known->second;
+    z3::context& z3ctx = s.z3ctx;
+    expr_map& closed_form = s.closed_forms[loop];
+    closed_form = solve_rec(inst, s.LI, z3ctx);
+    if (closed_form.size() != 0) {
+        // the closed forms hold for every iteration of the loop and of the ones around it
+        z3::expr_vector inv_vars(z3ctx);
+        z3::expr in_range = z3ctx.bool_val(true);
+        for (unsigned d = 0; d < loop->getLoopDepth(); d++) {
+            z3::expr inv_var = z3ctx.int_const(("n" + std::to_string(d)).data());
+            inv_vars.push_back(inv_var);
+            in_range = in_range && inv_var >= 0;
+        }
+        z3::expr_vector solved(z3ctx);
+        for (auto &i : closed_form) {
+            solved.push_back(quantify(inv_vars, z3::implies(in_range, i.first == i.second), i.first, z3ctx));
+        }
+        // on top of the recurrences rather than instead of them: the closed
+        // forms start from the initial values f(0) the phis define
+        s.facts(solved);
+    }
+    return closed_form;
+}
+
+// the updates and joins that produce the state m; versions in a loop are
+// quantified over its index, so a loop-indexed write becomes one array update axiom
+void expand_version(const memory_version* m, encoding_state& s) {
+    const LoopInfo& LI = s.LI;
+    z3::context& z3ctx = s.z3ctx;
+    if (!s.versions.insert(m).second) return;
+    // a store has one partition, its update is encoded once per query
+    if (m->kind == memory_version::stored && !s.visited.insert(m->store)) return;
+    const Loop* loop = LI.getLoopFor(m->block);
+    expand_loop(loop, s);
+    z3::expr_vector cur(z3ctx);
+    z3::expr_vector triggers(z3ctx);
+    z3::expr lhs = version_ref(m, m->block, false, LI, z3ctx);
+    if (m->kind == memory_version::stored) {
+        const StoreInst* store = m->store;
+        z3::expr offset = use2z3(store->getOperandUse(1), LI, z3ctx);
+        z3::expr value = use2z3(store->getOperandUse(0), LI, z3ctx);
+        cur.push_back(lhs == z3::store(version_ref(m->prev, m->block, false, LI, z3ctx), offset, value));
+        triggers.push_back(lhs);
+        s.facts(quantify_at(m->block, cur, triggers, LI, z3ctx));
+        s.value(store->getValueOperand());
+        s.value(store->getPointerOperand());
+        s.version(m->prev);
+    } else if (m->kind == memory_version::merged) {
+        bool first_on_true = true;
+        const BranchInst* branch = nullptr;
+        if (loop && loop->getHeader() == m->block) {
+            // initial state on entry, the state at the latch afterwards
+            for (auto& in : m->incoming) {
+                if (!loop->contains(in.first)) {
+                    z3::expr_vector args_0(z3ctx);
+                    for (unsigned i = 0; i + 1 < loop->getLoopDepth(); i++) {
+                        std::string idx = std::string("n") + std::to_string(i);
+                        args_0.push_back(z3ctx.int_const(idx.data()));
+                    }
+                    args_0.push_back(z3ctx.int_val(0));
+                    z3::expr first = lhs.decl()(args_0);
+                    cur.push_back(first == version_ref(in.second, m->block, false, LI, z3ctx));
+                    triggers.push_back(first);
+                } else {
+                    cur.push_back(lhs == version_ref(in.second, m->block, loop->isLoopLatch(in.first), LI, z3ctx));
+                    triggers.push_back(lhs);
+                }
+            }
+        } else if (m->incoming.size() == 2 && (branch = deciding_branch(m->block, m->incoming[0].first, m->incoming[1].first, s.DT, s.PDT, first_on_true))) {
+            z3::expr cond = use2z3(branch->getOperandUse(0), LI, z3ctx);
+            z3::expr first = version_ref(m->incoming[0].second, m->block, false, LI, z3ctx);
+            z3::expr second = version_ref(m->incoming[1].second, m->block, false, LI, z3ctx);
+            cur.push_back(lhs == (first_on_true ? z3::ite(cond, first, second) : z3::ite(cond, second, first)));
+            triggers.push_back(lhs);
+            s.value(branch->getCondition());
+        }
+        // states joined any other way stay unconstrained
+        s.facts(quantify_at(m->block, cur, triggers, LI, z3ctx));
+        for (auto& in : m->incoming) {
+            s.version(in.second);
+        }
+    }
+    // initial states and states clobbered by calls are unconstrained
+}
+
+// x == M[offset] for the state M of the partition the load reads
+void expand_load(const LoadInst* load, encoding_state& s) {
+    auto model = memory_models.find(load->getFunction());
+    const memory_version* m = model == memory_models.end() ? nullptr : model->second->load_version(load);
+    if (!m) return;
+    z3::expr_vector cur(s.z3ctx);
+    z3::expr_vector triggers(s.z3ctx);
+    z3::expr lhs = def2z3(load, s.LI, s.z3ctx);
+    cur.push_back(lhs == z3::select(version_ref(m, load->getParent(), false, s.LI, s.z3ctx), use2z3(load->getOperandUse(0), s.LI, s.z3ctx)));
+    triggers.push_back(lhs);
+    s.facts(quantify_at(load->getParent(), cur, triggers, s.LI, s.z3ctx));
+    s.version(m);
+}
+
+void expand_value(const Value* v, encoding_state& s) {
+    const LoopInfo& LI = s.LI;
+    z3::context& z3ctx = s.z3ctx;
+    // errs() << v->getName() << "\n";
+    if (!s.visited.insert(v)) return;
+    auto inst = dyn_cast<Instruction>(v);
+    if (!inst) return;
+    if (const Loop* loop = LI.getLoopFor(inst->getParent())) {
+        // a load reads memory, its value has no closed form; the closed forms
+        // go ahead of the exit conditions, which are values of the loop as well
+        expr_map no_closed_form;
+        const expr_map& closed_form = isa<LoadInst>(inst) ? no_closed_form : expand_closed_forms(loop, inst, s);
+        expand_loop(loop, s);
+        if (Invariants && !isa<LoadInst>(inst) && loop->getLoopDepth() == 1 && !solves_header(loop, closed_form, z3ctx)
+            && s.invariant_loops.insert(loop).second) {
+            invariant_synthesis synthesis(loop, LI);
+            s.facts(synthesis.run(z3ctx));
+        }
+    }
+    unsigned opcode = inst->getOpcode();
+    if (opcode == Instruction::Call) {
+        const CallInst* call = dyn_cast<CallInst>(inst);
+        if (call_summaries && LI.getLoopDepth(call->getParent()) == 0) {
+            z3::expr_vector summary = call_summaries->instantiate(call, LI, z3ctx);
+            if (!summary.empty()) {
+                s.facts(summary);
+                for (const Use& arg : call->args()) {
+                    s.value(arg.get());
+                }
+            }
+        }
+        return;
+    }
+    if (opcode == Instruction::Load) {
+        expand_load(dyn_cast<LoadInst>(inst), s);
+    }
+    if (opcode == Instruction::PHI) {
+        inst = phi_as_select(dyn_cast<PHINode>(inst), s.DT, s.PDT);
+    }
+    s.facts(inst2z3(inst, LI, s.DT, s.PDT, s.loops, z3ctx));
+    for (const Use& u : inst->operands()) {
+        s.value(u.get());
+    }
+}
+
+}
+
+z3::expr_vector rel2z3(const Value* v, SetVector<const Value*>& visited, const LoopInfo& LI, const DominatorTree& DT, const PostDominatorTree& PDT, std::set<const Loop*>& loops, z3::context& z3ctx) {
+    z3::expr_vector res(z3ctx);
+    // the terms of the values are shared by all the facts encoded
+    translation_scope translator(function_of(v), z3ctx);
+    encoding_state s{visited, {}, {}, {}, LI, DT, PDT, loops, z3ctx, {}};
+    // depth first, children pushed in reverse, so the facts come out in the
+    // order of a recursive preorder walk without its stack depth
+    std::vector<work_item> todo;
+    if (auto inst = dyn_cast<Instruction>(v)) todo.reserve(inst->getFunction()->getInstructionCount());
+    todo.push_back(work_item{v, nullptr, z3::expr_vector(z3ctx)});
+    while (!todo.empty()) {
+        work_item item = todo.back();
+        todo.pop_back();
+        if (item.value) {
+            expand_value(item.value, s);
+        } else if (item.version) {
+            expand_version(item.version, s);
+        } else {
+            combine_vec(res, item.facts);
+            continue;
+        }
+        todo.insert(todo.end(), s.next.rbegin(), s.next.rend());
+        s.next.clear();
+    }
+    return res;
+}
+
+z3::expr_vector handle_loop(const Loop* loop, std::vector<const Value*>& exitConds, const LoopInfo& LI, z3::context& z3ctx) {
+    z3::expr_vector res(z3ctx);
+    SmallVector<BasicBlock*> exitingBBs;
+    loop->getExitingBlocks(exitingBBs);
+    std::vector<bool> true_or_false;
+    for (const auto bb : exitingBBs) {
+        const Instruction* terminator = bb->getTerminator();
+        if (auto CI = dyn_cast<BranchInst>(terminator)) {
+            assert(CI->isConditional());
+            const Value* cond = CI->getCondition();
+            exitConds.push_back(cond);
+            assert(CI->getNumSuccessors() == 2);
+            const BasicBlock* succ = CI->getSuccessor(0);
+            true_or_false.push_back(!loop->contains(succ));
+        } else {
+            errs() << "Unexpected Loop\n";
+            exit(0);
+        }
+    }
+    int depth = loop->getLoopDepth();
+    std::string N_name = std::string("N") + std::to_string(depth - 1);
+    z3::expr N = z3ctx.int_const(N_name.data());
+    z3::expr_vector args_in(z3ctx);
+    z3::expr_vector args_out(z3ctx);
+    z3::sort_vector param(z3ctx);
+    for (int j = 0; j < depth - 1; j++) {
+        param.push_back(z3ctx.int_sort());
+        std::string n_name = std::string("n") + std::to_string(j);
+        args_out.push_back(z3ctx.int_const(n_name.data()));
+    }
+    param.push_back(z3ctx.int_sort());
+    args_out.push_back(N);
+    std::string last_n_name = std::string("n") + std::to_string(depth - 1);
+    args_in.push_back(z3ctx.int_const(last_n_name.data()));
+
+    z3::expr_vector funcs_in_loop(z3ctx);
+    z3::expr_vector funcs_out_loop(z3ctx);
+    z3::expr final_out_cond(z3ctx.bool_val(false));
+    z3::expr final_in_cond(z3ctx.bool_val(true));
+    z3::expr in_trigger(z3ctx);
+    for (int i = 0; i < exitConds.size(); i++) {
+        z3::func_decl func = z3ctx.function(exitConds[i]->getName().data(), param, z3ctx.bool_sort());
+        if (i == 0) in_trigger = func(args_in);
+        // funcs_in_loop.push_back(func(args_in));
+        // funcs_out_loop.push_back(func(args_out));
+        final_out_cond = final_out_cond || (true_or_false[i] ? func(args_out) : !func(args_out));
+        final_in_cond = final_in_cond && !(true_or_false[i] ? func(args_in) : !func(args_in));
+    }
+
+    res.push_back(simplified(final_out_cond));
+    z3::expr in_body = z3::implies(args_in.back() < args_out.back() && args_in.back() >= 0, final_in_cond);
+    final_in_cond = exitConds.empty() ? z3::forall(args_in, in_body) : quantify(args_in, in_body, in_trigger, z3ctx);
+    res.push_back(simplified(final_in_cond));
+    res.push_back(args_out.back() >= 0);
+    return res;
+}
+
+// the disjunction over the acyclic paths from the entry; every block's condition
+// is built once, after those of its predecessors
+z3::expr path_condition(const BasicBlock* bb, const LoopInfo& LI, z3::context& z3ctx) {
+    const BasicBlock* entry = &(bb->getParent()->getEntryBlock());
+    auto back_edge = [&](const BasicBlock* pred, const BasicBlock* cur) {
+        Loop* loop = LI.getLoopFor(cur);
+        return loop && LI.isLoopHeader(cur) && loop->contains(pred) && loop->isLoopLatch(pred);
+    };
+    std::map<const BasicBlock*, z3::expr> pc;
+    std::set<const BasicBlock*> open;
+    // (block, whether its predecessors are done)
+    std::vector<std::pair<const BasicBlock*, bool>> todo;
+    todo.reserve(bb->getParent()->size());
+    todo.emplace_back(bb, false);
+    while (!todo.empty()) {
+        const BasicBlock* cur = todo.back().first;
+        bool preds_done = todo.back().second;
+        todo.pop_back();
+        if (pc.count(cur)) continue;
+        if (cur == entry) {
+            pc.emplace(cur, z3ctx.bool_val(true));
+            continue;
+        }
+        if (!preds_done) {
+            // a cycle not closed by a latch contributes no path
+            if (!open.insert(cur).second) continue;
+            todo.emplace_back(cur, true);
+            for (const BasicBlock* pred : predecessors(cur)) {
+                if (!back_edge(pred, cur) && !pc.count(pred)) todo.emplace_back(pred, false);
+            }
+            continue;
+        }
+        z3::expr res(z3ctx, z3ctx.bool_val(false));
+        for (const BasicBlock* pred : predecessors(cur)) {
+            if (back_edge(pred, cur)) continue;
+            auto pred_cond = pc.find(pred);
+            if (pred_cond == pc.end()) continue;
+            z3::expr cur_expr(z3ctx, z3ctx.bool_val(true));
+            const Instruction* term = pred->getTerminator();
+            const BranchInst* br = dyn_cast<BranchInst>(term);
+            if (br->isConditional()) {
+                int idx = 0;
+                for (idx = 0; idx < term->getNumSuccessors(); idx++) {
+                    if (cur == term->getSuccessor(idx)) {
+                        break;
+                    }
+                }
+                cur_expr = use2z3(br->getOperandUse(0), LI, z3ctx, false, true);
+                if (idx == 1) {
+                    cur_expr = !cur_expr;
+                }
+            }
+            res = res || (pred_cond->second && cur_expr);
+        }
+        pc.emplace(cur, res);
+    }
+    return pc.at(bb);
+}
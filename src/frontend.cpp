@@ -0,0 +1,28 @@
+#include "frontend.h"
+#include "clang/Basic/DiagnosticOptions.h"
+#include "clang/CodeGen/CodeGenAction.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/CompilerInvocation.h"
+#include "clang/Frontend/Utils.h"
+
+using namespace llvm;
+
+std::unique_ptr<Module> compile_c(const std::string& path, const std::vector<std::string>& extra_args, LLVMContext& ctx) {
+    // without -disable-O0-optnone every function is optnone and the normalization passes skip it
+    std::vector<const char*> args = {"clang", "-Xclang", "-disable-O0-optnone", "-resource-dir", C2Z3_CLANG_RESOURCE_DIR};
+    for (const std::string& arg : extra_args) {
+        args.push_back(arg.c_str());
+    }
+    args.push_back(path.c_str());
+
+    IntrusiveRefCntPtr<clang::DiagnosticsEngine> diags = clang::CompilerInstance::createDiagnostics(new clang::DiagnosticOptions());
+    std::shared_ptr<clang::CompilerInvocation> invocation = clang::createInvocationFromCommandLine(args, diags);
+    if (!invocation) return nullptr;
+
+    clang::CompilerInstance ci;
+    ci.setInvocation(invocation);
+    ci.createDiagnostics();
+    clang::EmitLLVMOnlyAction action(&ctx);
+    if (!ci.ExecuteAction(action)) return nullptr;
+    return action.takeModule();
+}
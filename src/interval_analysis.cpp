@@ -0,0 +1,371 @@
+#include "interval_analysis.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Operator.h"
+
+#include <algorithm>
+#include <climits>
+
+using namespace llvm;
+
+static const int64_t NEG_INF = INT64_MIN;
+static const int64_t POS_INF = INT64_MAX;
+static const unsigned max_rounds = 1000;
+
+interval interval::top() {
+    return interval{NEG_INF, POS_INF};
+}
+
+interval interval::of_type(const Type* ty) {
+    if (!ty->isIntegerTy()) return top();
+    unsigned width = ty->getIntegerBitWidth();
+    // booleans are 0/1 throughout, matching how assert and branches read them
+    if (width == 1) return interval{0, 1};
+    if (width >= 64) return top();
+    return interval{-(int64_t(1) << (width - 1)), (int64_t(1) << (width - 1)) - 1};
+}
+
+interval interval::constant(int64_t v) {
+    return interval{v, v};
+}
+
+bool interval::is_bottom() const {
+    return lo > hi;
+}
+
+bool interval::is_constant() const {
+    return lo == hi;
+}
+
+interval interval::join(const interval& other) const {
+    if (is_bottom()) return other;
+    if (other.is_bottom()) return *this;
+    return interval{std::min(lo, other.lo), std::max(hi, other.hi)};
+}
+
+interval interval::meet(const interval& other) const {
+    return interval{std::max(lo, other.lo), std::min(hi, other.hi)};
+}
+
+interval interval::widen(const interval& next) const {
+    if (is_bottom()) return next;
+    return interval{next.lo < lo ? NEG_INF : lo, next.hi > hi ? POS_INF : hi};
+}
+
+bool interval::operator==(const interval& other) const {
+    return (is_bottom() && other.is_bottom()) || (lo == other.lo && hi == other.hi);
+}
+
+static int64_t saturate(__int128 v) {
+    if (v <= NEG_INF) return NEG_INF;
+    if (v >= POS_INF) return POS_INF;
+    return (int64_t)v;
+}
+
+static __int128 wide(int64_t v) {
+    return v;
+}
+
+// a result leaving the type's range may have wrapped around
+static interval fit(__int128 lo, __int128 hi, const Instruction& inst) {
+    interval range = interval::of_type(inst.getType());
+    if (lo >= range.lo && hi <= range.hi) return interval{saturate(lo), saturate(hi)};
+    if (isa<OverflowingBinaryOperator>(inst) && inst.hasNoSignedWrap()) {
+        return interval{saturate(lo), saturate(hi)}.meet(range);
+    }
+    return range;
+}
+
+interval_analysis::interval_analysis(const Function& F, const LoopInfo& LI): F(F), LI(LI) {}
+
+interval interval_analysis::eval(const Value* v, const state& s) const {
+    if (auto CI = dyn_cast<ConstantInt>(v)) {
+        if (CI->getBitWidth() == 1) return interval::constant(CI->getZExtValue());
+        if (CI->getBitWidth() > 64) return interval::top();
+        return interval::constant(CI->getSExtValue());
+    }
+    auto it = s.find(v);
+    if (it != s.end()) return it->second;
+    it = defs.find(v);
+    if (it != defs.end()) return it->second;
+    return interval::of_type(v->getType());
+}
+
+interval interval_analysis::transfer(const Instruction& inst, const state& s) const {
+    if (auto BO = dyn_cast<BinaryOperator>(&inst)) {
+        interval a = eval(BO->getOperand(0), s);
+        interval b = eval(BO->getOperand(1), s);
+        if (a.is_bottom() || b.is_bottom()) return interval{1, 0};
+        bool finite = a.lo != NEG_INF && a.hi != POS_INF && b.lo != NEG_INF && b.hi != POS_INF;
+        switch (BO->getOpcode()) {
+            case Instruction::Add:
+                if (finite) return fit(wide(a.lo) + b.lo, wide(a.hi) + b.hi, inst);
+                break;
+            case Instruction::Sub:
+                if (finite) return fit(wide(a.lo) - b.hi, wide(a.hi) - b.lo, inst);
+                break;
+            case Instruction::Mul:
+                if (finite && a.lo > INT32_MIN && a.hi < INT32_MAX && b.lo > INT32_MIN && b.hi < INT32_MAX) {
+                    __int128 p[] = {wide(a.lo) * b.lo, wide(a.lo) * b.hi, wide(a.hi) * b.lo, wide(a.hi) * b.hi};
+                    return fit(*std::min_element(p, p + 4), *std::max_element(p, p + 4), inst);
+                }
+                break;
+            case Instruction::SRem:
+            case Instruction::URem: {
+                if (!b.is_constant() || b.lo == 0 || b.lo == NEG_INF) break;
+                if (BO->getOpcode() == Instruction::URem && (a.lo < 0 || b.lo < 0)) break;
+                int64_t m = std::abs(b.lo) - 1;
+                if (a.lo >= 0) return interval{0, std::min(m, a.hi)};
+                if (a.hi <= 0) return interval{std::max(-m, a.lo), 0};
+                return interval{-m, m};
+            }
+            case Instruction::SDiv:
+            case Instruction::UDiv:
+                if (!b.is_constant() || b.lo <= 0) break;
+                if (BO->getOpcode() == Instruction::UDiv && a.lo < 0) break;
+                return interval{a.lo / b.lo, a.hi / b.lo};
+            case Instruction::And:
+                if (b.is_constant() && b.lo >= 0) return interval{0, b.lo};
+                if (a.is_constant() && a.lo >= 0) return interval{0, a.lo};
+                break;
+            default:
+                break;
+        }
+        return interval::of_type(inst.getType());
+    }
+    if (auto CI = dyn_cast<ICmpInst>(&inst)) {
+        interval a = eval(CI->getOperand(0), s);
+        interval b = eval(CI->getOperand(1), s);
+        if (a.is_bottom() || b.is_bottom()) return interval{1, 0};
+        ICmpInst::Predicate pred = CI->getPredicate();
+        // unsigned comparisons agree with signed ones on non-negative ranges
+        if (CI->isUnsigned()) {
+            if (a.lo < 0 || b.lo < 0) return interval{0, 1};
+            pred = CI->getSignedPredicate();
+        }
+        switch (pred) {
+            case ICmpInst::ICMP_SLT: std::swap(a, b); LLVM_FALLTHROUGH;
+            case ICmpInst::ICMP_SGT:
+                if (a.lo > b.hi) return interval::constant(1);
+                if (a.hi <= b.lo) return interval::constant(0);
+                break;
+            case ICmpInst::ICMP_SLE: std::swap(a, b); LLVM_FALLTHROUGH;
+            case ICmpInst::ICMP_SGE:
+                if (a.lo >= b.hi) return interval::constant(1);
+                if (a.hi < b.lo) return interval::constant(0);
+                break;
+            case ICmpInst::ICMP_EQ:
+                if (a.is_constant() && b.is_constant() && a.lo == b.lo) return interval::constant(1);
+                if (a.meet(b).is_bottom()) return interval::constant(0);
+                break;
+            case ICmpInst::ICMP_NE:
+                if (a.is_constant() && b.is_constant() && a.lo == b.lo) return interval::constant(0);
+                if (a.meet(b).is_bottom()) return interval::constant(1);
+                break;
+            default:
+                break;
+        }
+        return interval{0, 1};
+    }
+    if (auto SI = dyn_cast<SelectInst>(&inst)) {
+        interval c = eval(SI->getCondition(), s);
+        if (c == interval::constant(1)) return eval(SI->getTrueValue(), s);
+        if (c == interval::constant(0)) return eval(SI->getFalseValue(), s);
+        return eval(SI->getTrueValue(), s).join(eval(SI->getFalseValue(), s));
+    }
+    if (auto CI = dyn_cast<CastInst>(&inst)) {
+        interval a = eval(CI->getOperand(0), s);
+        interval range = interval::of_type(CI->getType());
+        const Type* src = CI->getOperand(0)->getType();
+        switch (CI->getOpcode()) {
+            case Instruction::ZExt:
+                if (a.lo >= 0) return a;
+                break;
+            case Instruction::SExt:
+                if (src->isIntegerTy(1)) return interval{-a.hi, -a.lo};
+                return a;
+            case Instruction::Trunc:
+                if (a.lo >= range.lo && a.hi <= range.hi) return a;
+                break;
+            default:
+                break;
+        }
+        return range;
+    }
+    return interval::of_type(inst.getType());
+}
+
+static bool is_tracked(const Value* v) {
+    return (isa<Instruction>(v) || isa<Argument>(v)) && v->getType()->isIntegerTy();
+}
+
+void interval_analysis::refine(const Value* cond, bool taken, state& s) const {
+    if (is_tracked(cond)) s[cond] = interval::constant(taken ? 1 : 0);
+    if (auto BO = dyn_cast<BinaryOperator>(cond)) {
+        // both sides of a taken `and` (or a failed `or`) hold
+        if ((BO->getOpcode() == Instruction::And && taken) || (BO->getOpcode() == Instruction::Or && !taken)) {
+            if (BO->getType()->isIntegerTy(1)) {
+                refine(BO->getOperand(0), taken, s);
+                refine(BO->getOperand(1), taken, s);
+            }
+        }
+        return;
+    }
+    auto CI = dyn_cast<ICmpInst>(cond);
+    if (!CI) return;
+    const Value* lhs = CI->getOperand(0);
+    const Value* rhs = CI->getOperand(1);
+    interval a = eval(lhs, s);
+    interval b = eval(rhs, s);
+    ICmpInst::Predicate pred = taken ? CI->getPredicate() : CI->getInversePredicate();
+    if (CI->isUnsigned()) {
+        if (a.lo < 0 || b.lo < 0) return;
+        pred = ICmpInst::getSignedPredicate(pred);
+    }
+    switch (pred) {
+        case ICmpInst::ICMP_SLT:
+            a.hi = std::min(a.hi, saturate(wide(b.hi) - 1));
+            b.lo = std::max(b.lo, saturate(wide(a.lo) + 1));
+            break;
+        case ICmpInst::ICMP_SLE:
+            a.hi = std::min(a.hi, b.hi);
+            b.lo = std::max(b.lo, a.lo);
+            break;
+        case ICmpInst::ICMP_SGT:
+            a.lo = std::max(a.lo, saturate(wide(b.lo) + 1));
+            b.hi = std::min(b.hi, saturate(wide(a.hi) - 1));
+            break;
+        case ICmpInst::ICMP_SGE:
+            a.lo = std::max(a.lo, b.lo);
+            b.hi = std::min(b.hi, a.hi);
+            break;
+        case ICmpInst::ICMP_EQ:
+            a = b = a.meet(b);
+            break;
+        case ICmpInst::ICMP_NE:
+            if (b.is_constant()) {
+                if (a.lo == b.lo) a.lo++;
+                else if (a.hi == b.lo) a.hi--;
+            }
+            if (a.is_constant()) {
+                if (b.lo == a.lo) b.lo++;
+                else if (b.hi == a.lo) b.hi--;
+            }
+            break;
+        default:
+            break;
+    }
+    if (is_tracked(lhs)) s[lhs] = a;
+    if (is_tracked(rhs)) s[rhs] = b;
+}
+
+interval_analysis::state interval_analysis::edge(const BasicBlock* from, const BasicBlock* to) const {
+    state s = out.lookup(from);
+    auto br = dyn_cast<BranchInst>(from->getTerminator());
+    if (br && br->isConditional() && br->getSuccessor(0) != br->getSuccessor(1)) {
+        refine(br->getCondition(), br->getSuccessor(0) == to, s);
+    }
+    return s;
+}
+
+bool interval_analysis::visit(const BasicBlock* bb, bool widen) {
+    state s;
+    bool reached = bb == &F.getEntryBlock();
+    std::vector<std::pair<const BasicBlock*, state>> edges;
+    for (const BasicBlock* pred : predecessors(bb)) {
+        if (!out.count(pred)) continue;
+        state e = edge(pred, bb);
+        // an edge whose condition is refuted (some range became empty) is infeasible
+        bool feasible = true;
+        for (auto& i : e) {
+            feasible = feasible && !i.second.is_bottom();
+        }
+        if (!feasible) continue;
+        if (!reached) {
+            s = e;
+        } else {
+            // values live here dominate bb and appear on every path; others are dropped
+            state joined;
+            for (auto& i : s) {
+                auto other = e.find(i.first);
+                if (other != e.end()) joined[i.first] = i.second.join(other->second);
+            }
+            s = joined;
+        }
+        reached = true;
+        edges.emplace_back(pred, std::move(e));
+    }
+    if (!reached) return false;
+    for (const PHINode& phi : bb->phis()) {
+        if (!phi.getType()->isIntegerTy()) continue;
+        interval v{1, 0};
+        for (auto& e : edges) {
+            v = v.join(eval(phi.getIncomingValueForBlock(e.first), e.second));
+        }
+        s[&phi] = v;
+    }
+    for (const Instruction& inst : *bb) {
+        if (isa<PHINode>(inst) || !inst.getType()->isIntegerTy()) continue;
+        s[&inst] = transfer(inst, s);
+    }
+    auto old = out.find(bb);
+    if (old != out.end()) {
+        if (widen) {
+            for (auto& i : s) {
+                auto prev = old->second.find(i.first);
+                if (prev != old->second.end()) i.second = prev->second.widen(i.second);
+            }
+        }
+        bool same = old->second.size() == s.size();
+        for (auto& i : s) {
+            auto prev = old->second.find(i.first);
+            same = same && prev != old->second.end() && prev->second == i.second;
+        }
+        if (same) return false;
+    }
+    for (const Instruction& inst : *bb) {
+        auto it = s.find(&inst);
+        if (it != s.end()) defs[&inst] = it->second;
+    }
+    out[bb] = std::move(s);
+    return true;
+}
+
+void interval_analysis::run(unsigned widen_delay, unsigned narrowing_passes) {
+    ReversePostOrderTraversal<const Function*> rpo(&F);
+    DenseMap<const BasicBlock*, unsigned> visits;
+    bool changed = true;
+    unsigned rounds = 0;
+    while (changed) {
+        changed = false;
+        for (const BasicBlock* bb : rpo) {
+            bool widen = LI.isLoopHeader(bb) && ++visits[bb] > widen_delay;
+            changed = visit(bb, widen) || changed;
+        }
+        if (++rounds > max_rounds) {
+            // no fixpoint, fall back to knowing nothing
+            out.clear();
+            defs.clear();
+            return;
+        }
+    }
+    // re-applying the transfer functions to a post-fixpoint stays above the least fixpoint
+    for (unsigned i = 0; i < narrowing_passes; i++) {
+        for (const BasicBlock* bb : rpo) {
+            visit(bb, false);
+        }
+    }
+}
+
+interval interval_analysis::range(const Value* v) const {
+    return eval(v, state());
+}
+
+bool interval_analysis::proves(const Use& cond) const {
+    const Instruction* call = cast<Instruction>(cond.getUser());
+    auto it = out.find(call->getParent());
+    if (it == out.end()) return false;
+    interval c = eval(cond.get(), it->second);
+    if (c.is_bottom()) return false;
+    return c.lo > 0 || c.hi < 0;
+}
@@ -0,0 +1,340 @@
+#include "invariants.h"
+#include "encoder.h"
+
+#include <numeric>
+#include <string>
+#include <utility>
+
+using namespace llvm;
+
+static affine combine(const affine& a, const affine& b, int64_t scale) {
+    affine res = a;
+    for (auto& term : b.coeffs) {
+        res.coeffs[term.first] += scale * term.second;
+    }
+    res.constant += scale * b.constant;
+    return res;
+}
+
+static affine scaled(const affine& a, int64_t scale) {
+    return combine(affine(), a, scale);
+}
+
+invariant_synthesis::invariant_synthesis(const Loop* loop, const LoopInfo& LI): loop(loop), LI(LI) {}
+
+// walked with an explicit stack, as the encoder does
+bool invariant_synthesis::translate(const Value* v, const std::set<const PHINode*>& phis, affine& res, bool havoc) {
+    std::map<const Value*, affine> done;
+    std::vector<std::pair<const Value*, bool>> todo;
+    auto input = [&](const Value* cur) {
+        if (!havoc) return false;
+        inputs.insert(cur);
+        affine a;
+        a.coeffs[cur] = 1;
+        done.emplace(cur, a);
+        return true;
+    };
+    todo.emplace_back(v, false);
+    while (!todo.empty()) {
+        const Value* cur = todo.back().first;
+        bool operands_done = todo.back().second;
+        todo.pop_back();
+        if (done.count(cur)) continue;
+        if (!cur->getType()->isIntegerTy() || cur->getType()->isIntegerTy(1)) return false;
+        if (auto CI = dyn_cast<ConstantInt>(cur)) {
+            affine a;
+            a.constant = CI->getSExtValue();
+            done.emplace(cur, a);
+            continue;
+        }
+        const Instruction* inst = dyn_cast<Instruction>(cur);
+        if (!inst || !loop->contains(inst)) {
+            // loop-invariant, a variable of its own
+            affine a;
+            a.coeffs[cur] = 1;
+            done.emplace(cur, a);
+            continue;
+        }
+        if (LI.getLoopFor(inst->getParent()) != loop) {
+            if (!input(cur)) return false;
+            continue;
+        }
+        if (auto phi = dyn_cast<PHINode>(inst)) {
+            if (!phis.count(phi)) {
+                if (!input(cur)) return false;
+                continue;
+            }
+            affine a;
+            a.coeffs[cur] = 1;
+            done.emplace(cur, a);
+            continue;
+        }
+        unsigned opcode = inst->getOpcode();
+        bool supported = opcode == Instruction::Add || opcode == Instruction::Sub || opcode == Instruction::Mul
+            || opcode == Instruction::Shl || isa<SExtInst>(inst) || isa<ZExtInst>(inst) || isa<TruncInst>(inst);
+        for (const Use& u : inst->operands()) {
+            supported = supported && u->getType()->isIntegerTy() && !u->getType()->isIntegerTy(1);
+        }
+        if (!supported) {
+            if (!input(cur)) return false;
+            continue;
+        }
+        if (!operands_done) {
+            todo.emplace_back(cur, true);
+            for (const Use& u : inst->operands()) {
+                todo.emplace_back(u.get(), false);
+            }
+            continue;
+        }
+        const affine& op0 = done.at(inst->getOperand(0));
+        affine a;
+        if (inst->getNumOperands() == 1) {
+            a = op0;
+        } else {
+            const affine& op1 = done.at(inst->getOperand(1));
+            if (opcode == Instruction::Add) {
+                a = combine(op0, op1, 1);
+            } else if (opcode == Instruction::Sub) {
+                a = combine(op0, op1, -1);
+            } else if (opcode == Instruction::Mul && op0.coeffs.empty()) {
+                a = scaled(op1, op0.constant);
+            } else if (opcode == Instruction::Mul && op1.coeffs.empty()) {
+                a = scaled(op0, op1.constant);
+            } else if (opcode == Instruction::Shl && op1.coeffs.empty() && op1.constant >= 0 && op1.constant < 32) {
+                a = scaled(op0, int64_t(1) << op1.constant);
+            } else {
+                if (!input(cur)) return false;
+                continue;
+            }
+        }
+        done.emplace(cur, a);
+    }
+    res = done.at(v);
+    return true;
+}
+
+// g >= 0 for the integer comparison cmp evaluating to taken
+void invariant_synthesis::add_guard(const ICmpInst* cmp, bool taken, const std::set<const PHINode*>& phis) {
+    affine lhs;
+    affine rhs;
+    if (!translate(cmp->getOperand(0), phis, lhs) || !translate(cmp->getOperand(1), phis, rhs)) return;
+    ICmpInst::Predicate pred = taken ? cmp->getPredicate() : cmp->getInversePredicate();
+    affine diff = combine(lhs, rhs, -1);    // lhs - rhs
+    if (ICmpInst::isLT(pred)) {
+        guards.push_back(combine(scaled(diff, -1), affine{{}, -1}, 1));
+    } else if (ICmpInst::isLE(pred)) {
+        guards.push_back(scaled(diff, -1));
+    } else if (ICmpInst::isGT(pred)) {
+        guards.push_back(combine(diff, affine{{}, -1}, 1));
+    } else if (ICmpInst::isGE(pred)) {
+        guards.push_back(diff);
+    } else if (pred == ICmpInst::ICMP_EQ) {
+        guards.push_back(diff);
+        guards.push_back(scaled(diff, -1));
+    }
+}
+
+bool invariant_synthesis::prepare() {
+    const BasicBlock* header = loop->getHeader();
+    const BasicBlock* latch = loop->getLoopLatch();
+    const BasicBlock* preheader = loop->getLoopPreheader();
+    if (loop->getLoopDepth() != 1 || !latch || !preheader) return false;
+    std::set<const PHINode*> phis;
+    for (const PHINode& phi : header->phis()) {
+        if (phi.getType()->isIntegerTy() && !phi.getType()->isIntegerTy(1)) phis.insert(&phi);
+    }
+    // what an update computes other than affinely is an input of the iteration
+    for (const PHINode* phi : phis) {
+        affine update;
+        if (!translate(phi->getIncomingValueForBlock(latch), phis, update, true)) return false;
+        updates.emplace(phi, update);
+    }
+    if (phis.empty()) return false;
+    std::set<const Value*> invariant_values;
+    for (const PHINode* phi : phis) {
+        affine init;
+        if (!translate(phi->getIncomingValueForBlock(preheader), {}, init)) return false;
+        initial.emplace(phi, init);
+        for (auto& term : init.coeffs) {
+            invariant_values.insert(term.first);
+        }
+        for (auto& term : updates.at(phi).coeffs) {
+            if (!phis.count(dyn_cast<PHINode>(term.first)) && !inputs.count(term.first)) invariant_values.insert(term.first);
+        }
+        vars.push_back(phi);
+    }
+    auto br = dyn_cast<BranchInst>(header->getTerminator());
+    auto cmp = br && br->isConditional() ? dyn_cast<ICmpInst>(br->getCondition()) : nullptr;
+    if (cmp && loop->isLoopExiting(header)) {
+        // the iteration runs if the header's test stays in the loop
+        add_guard(cmp, loop->contains(br->getSuccessor(0)), phis);
+        for (const affine& g : guards) {
+            for (auto& term : g.coeffs) {
+                if (!phis.count(dyn_cast<PHINode>(term.first))) invariant_values.insert(term.first);
+            }
+        }
+    }
+    for (const Value* v : invariant_values) {
+        // loop-invariant values stay unchanged and start as themselves
+        affine self;
+        self.coeffs[v] = 1;
+        updates.emplace(v, self);
+        initial.emplace(v, self);
+        vars.push_back(v);
+    }
+    return true;
+}
+
+z3::expr_vector invariant_synthesis::run(z3::context& z3ctx, unsigned max_invariants, unsigned timeout) {
+    z3::expr_vector res(z3ctx);
+    if (!prepare()) return res;
+    // coefficients are searched in [-bound, bound]
+    const int bound = 4;
+    z3::context ctx;
+    auto coeff = [&](const affine& a, const Value* v) {
+        auto it = a.coeffs.find(v);
+        return ctx.int_val(it == a.coeffs.end() ? (int64_t)0 : it->second);
+    };
+    // c.x + d >= 0 holds initially and is inductive; c and d terms of ctx
+    auto farkas = [&](const std::vector<z3::expr>& c, const z3::expr& d) {
+        z3::expr_vector constraints(ctx);
+        z3::expr premise = ctx.bool_const("lambda");
+        z3::expr slack = ctx.real_const("delta");
+        constraints.push_back(slack >= 0);
+        z3::expr_vector mu(ctx);
+        for (unsigned i = 0; i < guards.size(); i++) {
+            mu.push_back(ctx.real_const(("mu" + std::to_string(i)).data()));
+            constraints.push_back(mu.back() >= 0);
+        }
+        // c.update(x) + d = lambda*(c.x + d) + sum mu_i*g_i(x) + delta, for every x
+        for (unsigned k = 0; k < vars.size(); k++) {
+            z3::expr post = ctx.int_val(0);
+            for (unsigned j = 0; j < vars.size(); j++) {
+                post = post + c[j] * coeff(updates.at(vars[j]), vars[k]);
+            }
+            z3::expr pre = z3::to_real(z3::ite(premise, c[k], ctx.int_val(0)));
+            for (unsigned i = 0; i < guards.size(); i++) {
+                pre = pre + mu[i] * z3::to_real(coeff(guards[i], vars[k]));
+            }
+            constraints.push_back(z3::to_real(post) == pre);
+        }
+        // no premise constrains an input, the post-state must not depend on it
+        for (const Value* v : inputs) {
+            z3::expr post = ctx.int_val(0);
+            for (unsigned j = 0; j < vars.size(); j++) {
+                post = post + c[j] * coeff(updates.at(vars[j]), v);
+            }
+            constraints.push_back(post == 0);
+        }
+        z3::expr post = d;
+        z3::expr init = d;
+        for (unsigned j = 0; j < vars.size(); j++) {
+            post = post + c[j] * ctx.int_val(updates.at(vars[j]).constant);
+            init = init + c[j] * ctx.int_val(initial.at(vars[j]).constant);
+        }
+        z3::expr pre = z3::to_real(z3::ite(premise, d, ctx.int_val(0))) + slack;
+        for (unsigned i = 0; i < guards.size(); i++) {
+            pre = pre + mu[i] * z3::to_real(ctx.int_val(guards[i].constant));
+        }
+        constraints.push_back(z3::to_real(post) == pre);
+        // on entry, for every value of the loop-invariant variables
+        constraints.push_back(init >= 0);
+        for (const Value* v : vars) {
+            if (isa<PHINode>(v) && cast<Instruction>(v)->getParent() == loop->getHeader()) continue;
+            z3::expr sum = ctx.int_val(0);
+            for (unsigned j = 0; j < vars.size(); j++) {
+                sum = sum + c[j] * coeff(initial.at(vars[j]), v);
+            }
+            constraints.push_back(sum == 0);
+        }
+        return constraints;
+    };
+
+    std::vector<z3::expr> c;
+    z3::expr nonzero = ctx.bool_val(false);
+    z3::expr support = ctx.int_val(0);
+    for (unsigned k = 0; k < vars.size(); k++) {
+        c.push_back(ctx.int_const(("c" + std::to_string(k)).data()));
+        nonzero = nonzero || c[k] != 0;
+        support = support + z3::ite(c[k] != 0, ctx.int_val(1), ctx.int_val(0));
+    }
+    z3::expr d = ctx.int_const("d");
+    // the invariants found, over one real per variable; implied ones are dropped
+    z3::solver known(ctx);
+    std::vector<z3::expr> x;
+    for (unsigned k = 0; k < vars.size(); k++) {
+        x.push_back(ctx.real_const(("x" + std::to_string(k)).data()));
+    }
+    z3::solver directions(ctx);
+    z3::params p(ctx);
+    p.set(":timeout", timeout);
+    directions.set(p);
+    directions.add(farkas(c, d));
+    directions.add(nonzero);
+    for (unsigned k = 0; k < vars.size(); k++) {
+        directions.add(c[k] >= -bound && c[k] <= bound);
+    }
+    // sparse templates first, they are the bounds and equalities proofs need
+    // directions are blocked for good, the support bound only for its round
+    unsigned attempts = 4 * max_invariants;
+    for (unsigned size = 1; size <= std::min<size_t>(vars.size(), 3) && res.size() < max_invariants; size++) {
+        z3::expr_vector sparse(ctx);
+        sparse.push_back(ctx.bool_const(("support" + std::to_string(size)).data()));
+        directions.add(z3::implies(sparse[0], support <= (int)size));
+        while (res.size() < max_invariants && attempts > 0 && directions.check(sparse) == z3::sat) {
+            attempts--;
+            z3::model m = directions.get_model();
+            std::vector<int64_t> found;
+            int64_t divisor = 0;
+            for (unsigned k = 0; k < vars.size(); k++) {
+                found.push_back(m.eval(c[k], true).get_numeral_int64());
+                divisor = std::gcd(divisor, found.back());
+            }
+            // and its positive multiples are not asked for again
+            z3::expr multiple = ctx.bool_val(true);
+            z3::expr same_sign = ctx.int_val(0);
+            std::vector<z3::expr> fixed;
+            for (unsigned k = 0; k < vars.size(); k++) {
+                found[k] /= divisor;
+                fixed.push_back(ctx.int_val(found[k]));
+                same_sign = same_sign + c[k] * ctx.int_val(found[k]);
+                for (unsigned l = 0; l < vars.size(); l++) {
+                    multiple = multiple && c[k] * ctx.int_val(found[l]) == c[l] * ctx.int_val(found[k]);
+                }
+            }
+            directions.add(!(multiple && same_sign > 0));
+            // the strongest bound in this direction
+            z3::optimize tightest(ctx);
+            tightest.set(p);
+            tightest.add(farkas(fixed, d));
+            z3::optimize::handle h = tightest.minimize(d);
+            if (tightest.check() != z3::sat) continue;
+            z3::expr lowest = tightest.lower(h).simplify();
+            if (!lowest.is_numeral()) continue;
+            int64_t offset = lowest.get_numeral_int64();
+            z3::expr over_x = ctx.real_val(offset);
+            for (unsigned k = 0; k < vars.size(); k++) {
+                over_x = over_x + ctx.real_val(found[k]) * x[k];
+            }
+            z3::expr_vector weaker(ctx);
+            weaker.push_back(over_x < 0);
+            if (known.check(weaker) == z3::unsat) continue;
+            known.add(over_x >= 0);
+            z3::expr inv(z3ctx);
+            for (unsigned k = 0; k < vars.size(); k++) {
+                if (found[k] == 0) continue;
+                z3::expr term(z3ctx);
+                if (auto phi = dyn_cast<PHINode>(vars[k]); phi && phi->getParent() == loop->getHeader()) {
+                    // the value in the iteration the loop exits in
+                    term = z3ctx.function(phi->getName().data(), z3ctx.int_sort(), z3ctx.int_sort())(z3ctx.int_const("N0"));
+                } else {
+                    term = def2z3(vars[k], LI, z3ctx);
+                }
+                if (found[k] != 1) term = found[k] == -1 ? -term : z3ctx.int_val(found[k]) * term;
+                inv = bool(inv) ? inv + term : term;
+            }
+            res.push_back(offset == 0 ? inv >= 0 : inv >= z3ctx.int_val(-offset));
+        }
+    }
+    return res;
+}
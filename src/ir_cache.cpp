@@ -0,0 +1,157 @@
+#include "ir_cache.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+#include <fstream>
+#include <sstream>
+
+using namespace llvm;
+
+// bump whenever the normalization pipeline changes
+static const char* pipeline_version = "mem2reg,lcssa,simplifycfg,loop-simplify,instnamer,aggressive-instcombine";
+
+ir_cache::ir_cache(const std::string& dir, const std::string& input_path, StringRef contents, const std::set<std::string>& entries): unchanged(false), hit(false) {
+    SmallString<256> abs_path(input_path);
+    sys::fs::make_absolute(abs_path);
+    sys::fs::create_directories(dir);
+    base = dir + "/" + utohexstr(xxHash64(abs_path.str()));
+    content_hash = xxHash64(contents) ^ xxHash64(pipeline_version);
+    // the cached module has bodies only for what these entries reach
+    std::string entry_list;
+    for (const std::string& entry : entries) {
+        entry_list += entry + ",";
+    }
+    content_hash ^= xxHash64(entry_list);
+
+    std::ifstream idx(base + ".idx");
+    uint64_t cached_content;
+    if (!(idx >> std::hex >> cached_content)) return;
+    unchanged = cached_content == content_hash;
+    uint64_t h;
+    std::string name;
+    while (idx >> std::hex >> h >> name) {
+        normalized[name] = h;
+    }
+}
+
+std::unique_ptr<Module> ir_cache::load_unchanged(LLVMContext& ctx) {
+    if (!unchanged) return nullptr;
+    SMDiagnostic err;
+    std::unique_ptr<Module> mod = getLazyIRFileModule(base + ".bc", err, ctx);
+    hit = mod != nullptr;
+    return mod;
+}
+
+bool ir_cache::is_normalized(const Function& F) const {
+    return hit && normalized.count(F.getName().str());
+}
+
+uint64_t ir_cache::function_hash(const Function& F) {
+    std::string text;
+    raw_string_ostream os(text);
+    F.print(os);
+    os.flush();
+    // metadata is numbered module-wide, the ids F refers to (!dbg !12) shift
+    // with unrelated edits elsewhere, so only the attachment kinds are hashed
+    std::string stripped;
+    stripped.reserve(text.size());
+    for (size_t i = 0; i < text.size(); i++) {
+        stripped.push_back(text[i]);
+        if (text[i] != '!') continue;
+        while (i + 1 < text.size() && isdigit((unsigned char)text[i + 1])) i++;
+    }
+    return xxHash64(stripped);
+}
+
+bool ir_cache::reuse(Function& F, uint64_t raw_hash, LLVMContext& ctx) {
+    auto it = normalized.find(F.getName().str());
+    if (it == normalized.end() || it->second != raw_hash) return false;
+    if (!previous) {
+        SMDiagnostic err;
+        previous = getLazyIRFileModule(base + ".bc", err, ctx);
+        if (!previous) {
+            normalized.clear();
+            return false;
+        }
+    }
+    Function* old = previous->getFunction(F.getName());
+    if (!old || old->getFunctionType() != F.getFunctionType() || old->materialize() || old->isDeclaration()) return false;
+    return reuse_into(F, *old);
+}
+
+// clone the cached body into a scratch function first so F keeps its raw
+// body if the cached one does not fit this module
+bool ir_cache::reuse_into(Function& F, Function& old) {
+    Module& mod = *F.getParent();
+    Function* scratch = Function::Create(F.getFunctionType(), GlobalValue::ExternalLinkage, F.getName() + ".cached", &mod);
+    ValueToValueMapTy VMap;
+    for (GlobalValue& gv : previous->global_values()) {
+        if (GlobalValue* mine = mod.getNamedValue(gv.getName())) {
+            VMap[&gv] = mine;
+        }
+    }
+    auto new_arg = scratch->arg_begin();
+    for (Argument& arg : old.args()) {
+        VMap[&arg] = &*new_arg++;
+    }
+    SmallVector<ReturnInst*, 8> returns;
+    CloneFunctionInto(scratch, &old, VMap, CloneFunctionChangeType::DifferentModule, returns);
+    if (verifyFunction(*scratch)) {
+        scratch->eraseFromParent();
+        return false;
+    }
+    GlobalValue::LinkageTypes linkage = F.getLinkage();
+    F.deleteBody();
+    F.setLinkage(linkage);
+    F.getBasicBlockList().splice(F.end(), scratch->getBasicBlockList());
+    for (unsigned i = 0; i < F.arg_size(); i++) {
+        F.getArg(i)->setName(old.getArg(i)->getName());
+        scratch->getArg(i)->replaceAllUsesWith(F.getArg(i));
+    }
+    F.setSubprogram(scratch->getSubprogram());
+    scratch->eraseFromParent();
+    return true;
+}
+
+void ir_cache::record(const Function& F, uint64_t raw_hash) {
+    normalized[F.getName().str()] = raw_hash;
+    recorded.insert(F.getName().str());
+}
+
+void ir_cache::store(const Module& mod) {
+    // only the normalized bodies are written: the ones normalized in this run,
+    // and those of a module from load_unchanged it has loaded. Bodies lazy
+    // loading skipped stay unread, the rest of the functions become declarations
+    auto keep = [&](const Function& F) {
+        return !F.isDeclaration() && !F.isMaterializable() && normalized.count(F.getName().str())
+            && (hit || recorded.count(F.getName().str()));
+    };
+    ValueToValueMapTy VMap;
+    std::unique_ptr<Module> out = CloneModule(mod, VMap, [&](const GlobalValue* gv) {
+        auto F = dyn_cast<Function>(gv);
+        return !F || keep(*F);
+    });
+    // write next to the old entry and rename, a lazily loaded module may still map the old file
+    std::error_code ec;
+    {
+        raw_fd_ostream bc(base + ".bc.tmp", ec, sys::fs::OF_None);
+        if (ec) return;
+        WriteBitcodeToFile(*out, bc);
+    }
+    {
+        std::ofstream idx(base + ".idx.tmp");
+        idx << std::hex << content_hash << "\n";
+        for (const Function& F : mod) {
+            if (keep(F)) idx << std::hex << normalized.at(F.getName().str()) << " " << F.getName().str() << "\n";
+        }
+    }
+    sys::fs::rename(base + ".bc.tmp", base + ".bc");
+    sys::fs::rename(base + ".idx.tmp", base + ".idx");
+}
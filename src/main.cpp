@@ -7,655 +7,676 @@
 #include "llvm/IR/CFG.h"
 #include "llvm/IR/Dominators.h"
 #include "llvm/Analysis/PostDominators.h"
-#include "llvm/Transforms/Utils/LoopSimplify.h"
-#include "llvm/Transforms/Utils/LCSSA.h"
-#include "llvm/Transforms/Utils/Mem2Reg.h"
-#include "llvm/Transforms/Utils/InstructionNamer.h"
-#include "llvm/Transforms/Scalar/SimplifyCFG.h"
-#include "llvm/Transforms/AggressiveInstCombine/AggressiveInstCombine.h"
 #include "llvm/Analysis/InstructionSimplify.h"
 #include "llvm/Analysis/CGSCCPassManager.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/RegionInfo.h"
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/Analysis/MemorySSA.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Support/FileSystem.h"
 
 #include "z3++.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <map>
 #include <set>
 #include <fstream>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
 
 #include "rec_solver.h"
+#include "encoder.h"
+#include "pipeline.h"
+#include "summaries.h"
+#include "memory_model.h"
+#include "bmc.h"
+#include "worker_pool.h"
+#include "result_stream.h"
+#include "ir_cache.h"
+#include "concrete.h"
+#include "interval_analysis.h"
+#include "solver_config.h"
+#include "cube_solver.h"
+#include "query_log.h"
+#include "solver_backend.h"
+#include "daemon.h"
+#include "memory_budget.h"
+#ifdef C2Z3_WITH_CLANG
+#include "frontend.h"
+#endif
 
 using namespace llvm;
 
-z3::expr_vector handle_loop(const Loop* loop, std::vector<const Value*>& visited, const LoopInfo& LI, const DominatorTree& DT, const PostDominatorTree& PDT, std::set<const Loop*> loops, std::map<Value*, z3::expr_vector>& cached, z3::context& z3ctx);
-z3::expr def2z3(const Value* v, const LoopInfo& LI, z3::context &z3ctx);
-
-std::pair<z3::expr_vector, z3::expr_vector> map2expr_vector(const std::map<z3::expr, z3::expr>& m, z3::context& z3ctx) {
-    z3::expr_vector keys(z3ctx);
-    z3::expr_vector values(z3ctx);
-    for (auto& i : m) {
-        keys.push_back(i.first);
-        values.push_back(i.second);
+static cl::opt<std::string> InputFilename(cl::Positional, cl::desc("<input IR, bitcode or C file>"), cl::init(""), cl::cat(C2Z3Category));
+
+enum engine_kind { engine_quantified, engine_bmc, engine_auto };
+static cl::opt<engine_kind> Engine("engine", cl::desc("Decision procedure for the assertions"),
+    cl::values(clEnumValN(engine_quantified, "quantified", "Quantified loop axioms (default)"),
+               clEnumValN(engine_bmc, "bmc", "Incremental unrolling with k-induction"),
+               clEnumValN(engine_auto, "auto", "Quantified axioms, unrolling when the result is unknown")),
+    cl::init(engine_quantified), cl::cat(C2Z3Category));
+static cl::opt<unsigned> BMCBound("bmc-bound", cl::desc("Maximal number of unrolled loop iterations"), cl::init(100), cl::cat(C2Z3Category));
+static cl::opt<unsigned> BMCTimeout("bmc-timeout", cl::desc("Milliseconds the unrolling of one assertion may take in all (0 for no limit)"), cl::init(20000), cl::cat(C2Z3Category));
+static cl::opt<unsigned> Workers("workers", cl::desc("Check assertions in this many forked worker processes (0 checks in-process)"), cl::init(0), cl::cat(C2Z3Category));
+static cl::opt<unsigned> WorkerMemory("worker-memory", cl::desc("Address space limit of a worker in MB (0 for none)"), cl::init(4096), cl::cat(C2Z3Category));
+static cl::opt<unsigned> WorkerCPU("worker-cpu", cl::desc("CPU seconds a worker may spend on one assertion (0 for none)"), cl::init(60), cl::cat(C2Z3Category));
+static cl::opt<std::string> JSONOutput("json", cl::desc("Append one JSON record per assertion to this file ('-' for stdout)"), cl::init(""), cl::cat(C2Z3Category));
+static cl::list<std::string> EntryFunctions("entry", cl::desc("Functions whose assertions are checked (default: main)"), cl::CommaSeparated, cl::cat(C2Z3Category));
+static cl::opt<std::string> CacheDir("cache-dir", cl::desc("Cache normalized IR in this directory"), cl::init(""), cl::cat(C2Z3Category));
+static cl::list<std::string> CFlags("Xcc", cl::desc("Pass an argument to the in-process C frontend"), cl::cat(C2Z3Category));
+static cl::opt<unsigned> FalsifyRuns("falsify-runs", cl::desc("Concrete runs with boundary/random inputs before symbolic checking (0 disables)"), cl::init(0), cl::cat(C2Z3Category));
+static cl::opt<unsigned> FalsifySeed("falsify-seed", cl::desc("Seed for the random inputs of the concrete runs"), cl::init(0), cl::cat(C2Z3Category));
+static cl::opt<unsigned> FalsifyFuel("falsify-fuel", cl::desc("Instructions a concrete run may execute"), cl::init(1000000), cl::cat(C2Z3Category));
+static cl::opt<bool> Intervals("intervals", cl::desc("Discharge assertions by interval analysis before encoding"), cl::init(true), cl::cat(C2Z3Category));
+static cl::opt<bool> IntervalLemmas("interval-lemmas", cl::desc("Add the interval invariants to the solver query"), cl::init(false), cl::cat(C2Z3Category));
+static cl::opt<bool> MemoryModel("memory-model", cl::desc("Encode loads and stores with one array per allocation site"), cl::init(true), cl::cat(C2Z3Category));
+static cl::opt<bool> Summaries("summaries", cl::desc("Constrain calls by summaries of the callees"), cl::init(true), cl::cat(C2Z3Category));
+static cl::opt<unsigned> SummaryThreads("summary-threads", cl::desc("Threads summarizing independent callees (0 for one per core)"), cl::init(0), cl::cat(C2Z3Category));
+static cl::opt<unsigned> KInduction("k-induction", cl::desc("Maximal depth of k-induction steps while unrolling (0 disables)"), cl::init(16), cl::cat(C2Z3Category));
+static cl::opt<unsigned> CubeThreads("cubes", cl::desc("Split queries the solver gives up on into cubes solved on this many threads (0 disables)"), cl::init(0), cl::cat(C2Z3Category));
+enum simplify_kind { simplify_eager, simplify_deferred };
+static cl::opt<simplify_kind> Simplify("simplify", cl::desc("When the encoding is simplified"),
+    cl::values(clEnumValN(simplify_eager, "eager", "Every term as it is built (default)"),
+               clEnumValN(simplify_deferred, "deferred", "Once on the assembled query, by the -preprocess tactics")),
+    cl::init(simplify_eager), cl::cat(C2Z3Category));
+static cl::opt<std::string> Preprocess("preprocess", cl::desc("Comma-separated tactics run on the query with -simplify=deferred"), cl::init("simplify,propagate-values,solve-eqs"), cl::cat(C2Z3Category));
+static cl::list<std::string> Solvers("solver", cl::desc("Decide queries with 'z3' (the API, default) or an SMT-LIB2 solver command line; given several times, the solvers race"), cl::cat(C2Z3Category));
+static cl::opt<std::string> Record("record", cl::desc("Append every solver query, with its verdict and time, to this log (see c2z3-replay)"), cl::init(""), cl::cat(C2Z3Category));
+static cl::opt<std::string> Z3Config("z3-config", cl::desc("Load Z3 options from this file (as written by c2z3-tune)"), cl::init(""), cl::cat(C2Z3Category));
+static cl::opt<std::string> Serve("serve", cl::desc("Stay resident and verify the inputs that c2z3 -connect sends to this Unix socket, again only where they changed"), cl::init(""), cl::cat(C2Z3Category));
+static cl::opt<unsigned> MemoryBudget("memory-budget", cl::desc("Cap Z3's memory at this many MB, keep the query cache and the resident inputs of -serve within it, and report peak and steady-state RSS (0 for no budget)"), cl::init(0), cl::cat(C2Z3Category));
+static cl::opt<unsigned> ContextQueries("context-queries", cl::desc("Solver queries built in one Z3 context before it is replaced (0: never replaced)"), cl::init(1), cl::cat(C2Z3Category));
+static cl::opt<std::string> Connect("connect", cl::desc("Have the c2z3 -serve daemon on this Unix socket verify the input"), cl::init(""), cl::cat(C2Z3Category));
+
+solver_config z3_config;
+std::unique_ptr<solver_backend> backend;
+std::unique_ptr<query_log> recorder;
+std::unique_ptr<context_pool> contexts;
+rss_monitor rss;
+
+const char* verdict_name(z3::check_result r) {
+    switch (r) {
+        case z3::sat: return "Wrong";
+        case z3::unsat: return "Correct";
+        default: return "Unknown";
     }
-    return std::make_pair(keys, values);
 }
 
-void abortWithInfo(const std::string &s) {
-    errs() << s << "\n";
-    abort();
+double elapsed_ms(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
 }
 
-void combine_vec(z3::expr_vector& vec1, const z3::expr_vector& vec2) {
-    for (z3::expr e : vec2) {
-        vec1.push_back(e);
+// number of distinct AST nodes in the query
+unsigned query_size(const z3::expr_vector& query) {
+    std::set<unsigned> seen;
+    std::vector<z3::expr> todo;
+    for (z3::expr e : query) {
+        todo.push_back(e);
     }
+    while (!todo.empty()) {
+        z3::expr e = todo.back();
+        todo.pop_back();
+        if (!seen.insert(e.id()).second) continue;
+        if (e.is_app()) {
+            for (unsigned i = 0; i < e.num_args(); i++) {
+                todo.push_back(e.arg(i));
+            }
+        } else if (e.is_quantifier()) {
+            todo.push_back(e.body());
+        }
+    }
+    return seen.size();
 }
 
-z3::expr value2z3(const Value* v, const Loop* loop, z3::context& z3ctx, bool initial=false) {
-    z3::sort_vector args(z3ctx);
-    z3::expr_vector inv_vars(z3ctx);
-    int depth = loop->getLoopDepth();
-
-    for (int i = 0; i < depth; i++) {
-        std::string inv_var_name = "n" + std::to_string(i);
-        args.push_back(z3ctx.int_sort());
-        inv_vars.push_back(z3ctx.int_const(inv_var_name.data()));
-    }
-    // args.push_back(z3ctx.int_sort());
-    // if (initial) {
-    //     inv_vars.push_back(z3ctx.int_val(0));
-    // } else {
-    //     std::string inv_var_name = "n" + std::to_string(depth - 1);
-    //     inv_vars.push_back(z3ctx.int_const(inv_var_name.data()));
-    // }
-    const Type* vTy = v->getType();
-    bool isBoolTy = vTy->isIntegerTy(1);
-    z3::sort ret_sort = isBoolTy ? z3ctx.bool_sort() : z3ctx.int_sort();
-    z3::func_decl func = z3ctx.function(v->getName().data(), args, ret_sort);
-    if (auto CI = dyn_cast<ConstantInt>(v)) {
-        return z3ctx.int_val(CI->getSExtValue());
-    } else if (initial) {
-        return z3ctx.int_const(v->getName().data());
-    } else {
-        return func(inv_vars);
-        // return z3ctx.int_const(v->getName().data());
-    }
+std::string debug_location(const Use* u) {
+    const Instruction* user = dyn_cast<Instruction>(u->getUser());
+    const DebugLoc& loc = user->getDebugLoc();
+    if (!loc) return "";
+    return loc->getFilename().str() + ":" + std::to_string(loc.getLine()) + ":" + std::to_string(loc.getCol());
 }
 
-z3::expr get_initial_value(const PHINode* phi, const Loop* loop, z3::context& z3ctx) {
-    assert(phi->getNumIncomingValues() == 2);
-    for (int i = 0; i < phi->getNumIncomingValues(); i++) {
-        const BasicBlock* cur_bb = phi->getIncomingBlock(i);
-        if (!loop->contains(cur_bb)) {
-            const Value* incoming_v = phi->getIncomingValue(i);
-            return value2z3(incoming_v, loop, z3ctx, true);
+// lo <= v <= hi for the integer values of the query, header phis are bounded for 0 <= n0 <= N0
+z3::expr_vector interval_lemmas(const SetVector<const Value*>& visited, const interval_analysis& ai, const LoopInfo& LI, z3::context& z3ctx) {
+    z3::expr_vector lemmas(z3ctx);
+    for (const Value* v : visited) {
+        const Instruction* inst = dyn_cast<Instruction>(v);
+        if (!inst || !inst->getType()->isIntegerTy() || inst->getType()->isIntegerTy(1)) continue;
+        interval r = ai.range(v);
+        interval type_range = interval::of_type(v->getType());
+        if (r.is_bottom() || r == type_range) continue;
+        int depth = LI.getLoopDepth(inst->getParent());
+        auto bounded = [&](const z3::expr& e) {
+            z3::expr res = z3ctx.bool_val(true);
+            if (r.lo != type_range.lo) res = res && e >= z3ctx.int_val(r.lo);
+            if (r.hi != type_range.hi) res = res && e <= z3ctx.int_val(r.hi);
+            return res;
+        };
+        if (depth == 0) {
+            lemmas.push_back(bounded(def2z3(v, LI, z3ctx)));
+        } else if (depth == 1 && isa<PHINode>(inst) && LI.isLoopHeader(inst->getParent())) {
+            const Loop* loop = LI.getLoopFor(inst->getParent());
+            z3::expr n = z3ctx.int_const("n0");
+            z3::expr_vector vars(z3ctx);
+            vars.push_back(n);
+            z3::expr phi = value2z3(v, loop, z3ctx);
+            lemmas.push_back(quantify(vars, z3::implies(n >= 0 && n <= z3ctx.int_const("N0"), bounded(phi)), phi, z3ctx));
         }
     }
-    abortWithInfo("no initial value");
-    return z3ctx.int_val(0);
+    return lemmas;
 }
 
-const Value* get_rec_value(const PHINode* phi, const Loop* loop, z3::context& z3ctx) {
-    assert(phi->getNumIncomingValues() == 2);
-    for (int i = 0; i < phi->getNumIncomingValues(); i++) {
-        const BasicBlock* cur_bb = phi->getIncomingBlock(i);
-        if (loop->contains(cur_bb) && loop->isLoopLatch(cur_bb)) {
-            const Value* incoming_v = phi->getIncomingValue(i);
-            return incoming_v;
-        }
+// identical queries (e.g. repeated assertions) are answered once per process;
+// under -memory-budget the oldest are forgotten once their text outgrows a tenth of it
+std::map<std::string, z3::check_result> query_cache;
+std::deque<std::map<std::string, z3::check_result>::iterator> query_cache_order;
+size_t query_cache_bytes = 0;
+
+void remember_query(const std::string& smt2, z3::check_result result) {
+    auto entry = query_cache.insert_or_assign(smt2, result);
+    if (!entry.second) return;
+    query_cache_order.push_back(entry.first);
+    query_cache_bytes += smt2.size();
+    size_t limit = ((size_t)MemoryBudget << 20) / 10;
+    while (MemoryBudget > 0 && query_cache_bytes > limit && !query_cache_order.empty()) {
+        query_cache_bytes -= query_cache_order.front()->first.size();
+        query_cache.erase(query_cache_order.front());
+        query_cache_order.pop_front();
     }
-    abortWithInfo("no recursive value");
-    return nullptr;
 }
 
-z3::expr eliminate_tmp(const Value* v, const Loop* loop, z3::context& z3ctx) {
-    if (isa<Constant>(v)) return value2z3(v, loop, z3ctx);
-    const Instruction* ins = dyn_cast<Instruction>(v);
-    const BasicBlock* bb = ins->getParent();
-    if (!loop->contains(bb)) return value2z3(v, loop, z3ctx);
-    const BasicBlock* header = loop->getHeader();
-    if (auto phi = dyn_cast<PHINode>(v) && bb == header) {
-        return value2z3(v, loop, z3ctx);
-    }
-    int opcode = ins->getOpcode();
-    z3::expr res(z3ctx);
-    if (ins->isBinaryOp()) {
-        z3::expr op0 = value2z3(ins->getOperand(0), loop, z3ctx);
-        z3::expr op1 = value2z3(ins->getOperand(1), loop, z3ctx);
-        if (opcode == Instruction::Add) {
-            res = op0 + op1;
-        } else if (opcode == Instruction::Sub) {
-            res = op0 - op1;
-        } else if (opcode == Instruction::Mul) {
-            res = op0 * op1;
-        } else if (opcode == Instruction::SRem || opcode == Instruction::URem) {
-            res = op0 % op1;
-        } else {
-            abortWithInfo(std::string("unimplemented: ") + v->getName().data());
+assertion_result check_assertion(const std::string& function, int index, const Use* u, const LoopInfo& LI, const DominatorTree& DT, const PostDominatorTree& PDT, const interval_analysis* ai, z3::context& z3ctx, std::ofstream& out) {
+    assertion_result stats;
+    auto encode_start = std::chrono::steady_clock::now();
+    // const Instruction* defInst = dyn_cast<const Instruction>(v);
+    // the values are translated once for the assertion, the lemmas and the path condition
+    translation_scope translator(cast<Instruction>(u->getUser())->getFunction(), z3ctx);
+    z3::solver solver = z3_config.make_solver(z3ctx);
+    // solver.add(z3ctx.int_const("N0") == z3ctx.int_const("%i") || z3ctx.int_const("%i") < 0);
+    // solver.add(z3ctx.int_const("N0") == 0);
+    solver.add(!use2z3(*u, LI, z3ctx));
+    Value* v = u->get();
+    Instruction* user = dyn_cast<Instruction>(u->getUser());
+    const BasicBlock* assert_block = user->getParent();
+    // errs() << path_condition(assert_block, LI, z3ctx).simplify().to_string() << "\n";
+    SetVector<const Value*> visited;
+    std::set<const Loop*> loops;
+    z3::expr_vector all_z3 = rel2z3(v, visited, LI, DT, PDT, loops, z3ctx);
+    z3::expr path_cond = path_condition(assert_block, LI, z3ctx);
+    solver.add(all_z3);
+    solver.add(path_cond);
+    if (ai && IntervalLemmas) {
+        solver.add(interval_lemmas(visited, *ai, LI, z3ctx));
+    }
+    std::string smt2 = solver.to_smt2();
+    out << smt2;
+    stats.encode_ms = elapsed_ms(encode_start);
+    stats.query_size = query_size(solver.assertions());
+
+    auto solve_start = std::chrono::steady_clock::now();
+    auto hit = query_cache.find(smt2);
+    stats.cache_hit = hit != query_cache.end();
+    z3::check_result result = z3::unknown;
+    if (stats.cache_hit) {
+        result = hit->second;
+    } else {
+        // as asserted: once checked, the solver hands back its rewritten forms
+        z3::expr_vector asserted = solver.assertions();
+        if (Engine != engine_bmc) {
+            auto backend_start = std::chrono::steady_clock::now();
+            result = backend->check(solver, smt2, 3000u);
+            if (recorder->enabled()) {
+                query_record record;
+                record.function = function;
+                record.assertion = index;
+                record.backend = backend->name();
+                record.timeout_ms = 3000u;
+                record.config = z3_config.to_string();
+                record.result = result == z3::sat ? "sat" : result == z3::unsat ? "unsat" : "unknown";
+                record.solve_ms = elapsed_ms(backend_start);
+                record.smt2 = smt2;
+                recorder->append(record);
+            }
         }
-    } else if (auto CI = dyn_cast<ICmpInst>(v)) {
-        const ICmpInst::Predicate pred = CI->getPredicate();
-        z3::expr op0 = value2z3(ins->getOperand(0), loop, z3ctx);
-        z3::expr op1 = value2z3(ins->getOperand(1), loop, z3ctx);
-        if (ICmpInst::isLE(pred)) {
-            res = op0 <= op1;
-        } else if (ICmpInst::isLT(pred)) {
-            res = op0 < op1;
-        } else if (ICmpInst::isGT(pred)) {
-            res = op0 > op1;
-        } else if (ICmpInst::isGE(pred)) {
-            res = op0 >= op1;
-        } else if (ICmpInst::isEquality(pred)) {
-            res = (op0 == op1);
-        } else {
-            abortWithInfo(std::string("unimplemented: ") + v->getName().data());
+        // past memory_max_size a check gives up with unknown; the context is
+        // exhausted all the same
+        if (MemoryBudget > 0 && result == z3::unknown && solver.reason_unknown() == "out of memory") {
+            throw z3::exception("out of memory");
         }
-    } else if (auto CI = dyn_cast<SelectInst>(v)) {
-        const Value* cond = CI->getCondition();
-        // const Use& cond = CI->getOperandUse(0);
-        z3::expr z3cond = value2z3(cond, loop, z3ctx);
-        z3::expr op0 = value2z3(ins->getOperand(1), loop, z3ctx);
-        z3::expr op1 = value2z3(ins->getOperand(2), loop, z3ctx);
-        res = z3::ite(z3cond, op0, op1);
-    } else {
-        abortWithInfo(std::string("unimplemented: ") + v->getName().data());
+        if (Engine != engine_bmc && result == z3::unknown && CubeThreads > 0) {
+            cube_solver cubes(asserted, z3ctx);
+            cubes.split_paths(path_cond);
+            // all outermost loops share the trip count N0
+            if (!loops.empty()) cubes.split_trip_count(z3ctx.int_const("N0"), std::max(2u, CubeThreads / cubes.size()));
+            result = cubes.check(CubeThreads, 3000u);
+        }
+        if (Engine == engine_bmc || (Engine == engine_auto && result == z3::unknown)) {
+            bmc_engine bmc(asserted, z3ctx);
+            result = bmc.check(BMCBound, KInduction, 3000u, BMCTimeout);
+        }
+        remember_query(smt2, result);
     }
-    return res;
+    stats.solve_ms = elapsed_ms(solve_start);
+    stats.verdict = verdict_name(result);
+    return stats;
 }
 
-void loop_se(const Loop* loop, const LoopInfo& LI, std::map<const Value*, z3::expr>& rec, std::map<const Value*, z3::expr>& initial, z3::context& z3ctx) {
-    const BasicBlock* header = loop->getHeader();
-    for (auto& phi : header->phis()) {
-        initial.insert_or_assign(&phi, get_initial_value(&phi, loop, z3ctx));
-        // initial[&phi] = get_initial_value(&phi, loop, z3ctx);
-        const Value* rec_value = get_rec_value(&phi, loop, z3ctx);
-        z3::expr tmp2expr = eliminate_tmp(rec_value, loop, z3ctx);
-        rec.insert_or_assign(&phi, tmp2expr);
-        // rec[&phi] = tmp2expr;
+void test_solver() {
+    z3::context zctx;
+    z3::func_decl func = zctx.function("f", zctx.int_sort(), zctx.int_sort());
+    z3::expr n = zctx.int_const("n");
+    expr_map eqs;
+    eqs.insert_or_assign(func(n+1), 3*func(n) + 2);
+    rec_solver s(eqs, n, zctx);
+    s.simple_solve();
+    for (auto &i : s.get_res()) {
+        errs() << i.first.to_string() << " = " << i.second.to_string() << "\n";
     }
+    exit(0);
 }
 
-void find_phi_in_header(const Value* v, const Loop* loop, const LoopInfo& LI, std::set<const PHINode*>& phis) {
-    if (isa<Constant>(v)) return;
-    const BasicBlock* header = loop->getHeader();
-    const Instruction* ins = dyn_cast<Instruction>(v);
-    const BasicBlock* cur_bb = ins->getParent();
-    const Loop* cur_loop = LI.getLoopFor(cur_bb);
-    if (cur_loop != loop) {
-        return;
-    } else if (cur_bb == header && isa<PHINode>(ins)) {
-        phis.insert(dyn_cast<PHINode>(ins));
-    } else {
-        for (auto& operand : ins->operands()) {
-            Value* op_v = operand.get();
-            find_phi_in_header(op_v, loop, LI, phis);
-        }
+// bitcode is loaded lazily, function bodies are materialized on demand;
+// C sources are compiled in-process straight into ctx
+std::unique_ptr<Module> load_module(const std::string& path, SMDiagnostic& Err, LLVMContext& ctx) {
+    if (StringRef(path).endswith(".c")) {
+#ifdef C2Z3_WITH_CLANG
+        std::vector<std::string> cflags(CFlags.begin(), CFlags.end());
+        std::unique_ptr<Module> mod = compile_c(path, cflags, ctx);
+        if (!mod) Err = SMDiagnostic(path, SourceMgr::DK_Error, "compilation failed");
+        return mod;
+#else
+        Err = SMDiagnostic(path, SourceMgr::DK_Error, "c2z3 was built without the C frontend (C2Z3_WITH_CLANG)");
+        return nullptr;
+#endif
+    }
+    if (StringRef(path).endswith(".bc")) {
+        return getLazyIRFileModule(path, Err, ctx);
     }
+    return parseIRFile(path, Err, ctx);
 }
 
-std::map<z3::expr, z3::expr> solve_rec(const Value* v, const LoopInfo& LI, z3::context& z3ctx) {
-    std::map<z3::expr, z3::expr> res;
-    const Instruction* ins = dyn_cast<Instruction>(v);
-    Loop* loop = LI.getLoopFor(ins->getParent());
-    if (!loop) return res;
-    std::map<const Value*, z3::expr> initial;
-    std::map<const Value*, z3::expr> rec;
-    loop_se(loop, LI, rec, initial, z3ctx);
-    std::set<const PHINode*> phis;
-    find_phi_in_header(v, loop, LI, phis);
-    std::string ind_var_name = "n" + std::to_string(loop->getLoopDepth() - 1);
-    z3::expr last_ind_var = z3ctx.int_const(ind_var_name.data());
-    std::map<z3::expr, z3::expr> rec_eqs;
-    for (auto& i : rec) {
-        rec_eqs.insert_or_assign(def2z3(i.first, LI, z3ctx), i.second);
-    }
-    rec_solver rec_s(rec_eqs, last_ind_var, z3ctx);
-    // z3::expr v2expr = eliminate_tmp(v, loop, z3ctx);
-    // errs() << v2expr.to_string() << "\n";
-    // errs() << "********************\n";
-    rec_s.simple_solve();
-    rec_s.expr_solve(eliminate_tmp(v, loop, z3ctx));
-    res = rec_s.get_res();
-    return res;
+void materialize(Function& F) {
+    if (Error e = F.materialize()) {
+        logAllUnhandledErrors(std::move(e), errs(), "c2z3: ");
+        exit(1);
+    }
 }
 
-// only works for Use
-z3::expr use2z3(const Use& u, const LoopInfo& LI, z3::context &z3ctx, bool from_latch = false, bool exit_cond = false) {
-    z3::expr res(z3ctx);
-    const Value* v = u.get();
-    const User* user = u.getUser();
-    const Instruction* userInst = dyn_cast<Instruction>(user);
-    const BasicBlock* userBB = userInst->getParent();
-    Type* vTy = v->getType();
-
-    if (auto CI = dyn_cast<ConstantInt>(v)) {
-        bool isBoolTy = vTy->isIntegerTy(1);
-        if (isBoolTy) {
-            res = z3ctx.bool_val(*CI->getValue().getRawData() != 0);
-        } else {
-            res = z3ctx.int_val(CI->getSExtValue());
-        }
-    // } else if (auto CI = dyn_cast<ICmpInst>(v)) {
-    } else {
-        z3::expr_vector args(z3ctx);
-        z3::sort_vector sorts(z3ctx);
-        int userDepth = LI.getLoopDepth(userBB);
-        const Instruction* defInst = dyn_cast<Instruction>(v);
-        const BasicBlock* defBB = defInst->getParent();
-        int defDepth = LI.getLoopDepth(defBB);
-        for (int i = 0; i < defDepth - 1; i++) {
-            sorts.push_back(z3ctx.int_sort());
-            std::string idx = std::string("n") + std::to_string(i);
-            args.push_back(z3ctx.int_const(idx.data()));
-        }
+std::set<std::string> entry_functions() {
+    std::set<std::string> entries(EntryFunctions.begin(), EntryFunctions.end());
+    if (entries.empty()) entries.insert("main");
+    return entries;
+}
 
-        if (defDepth > 0) {
-            sorts.push_back(z3ctx.int_sort());
-            std::string idx = std::string("n") + std::to_string(defDepth - 1);
-            if (userDepth < defDepth || exit_cond) {
-                idx = std::string("N") + std::to_string(defDepth - 1);
-                args.push_back(z3ctx.int_const(idx.data()));
-            } else {
-                if (from_latch) {
-                    args.push_back(z3ctx.int_const(idx.data()));
-                } else {
-                    args.push_back(z3ctx.int_const(idx.data()) + 1);
-                }
-            }
+// the entry functions that contain assertions, and everything they call
+std::set<Function*> reachable_from_assertions(Module& mod, std::set<Function*>& targets) {
+    std::vector<Function*> worklist;
+    for (const std::string& name : entry_functions()) {
+        Function* F = mod.getFunction(name);
+        if (!F) continue;
+        materialize(*F);
+        if (F->isDeclaration() || collect_assertions(*F).empty()) continue;
+        targets.insert(F);
+        worklist.push_back(F);
+    }
+    std::set<Function*> reachable(targets.begin(), targets.end());
+    while (!worklist.empty()) {
+        Function* F = worklist.back();
+        worklist.pop_back();
+        for (auto& inst : instructions(*F)) {
+            auto call = dyn_cast<CallBase>(&inst);
+            Function* callee = call ? call->getCalledFunction() : nullptr;
+            if (!callee || reachable.count(callee)) continue;
+            materialize(*callee);
+            if (callee->isDeclaration()) continue;
+            reachable.insert(callee);
+            worklist.push_back(callee);
         }
-        bool isBoolTy = vTy->isIntegerTy(1);
-        z3::sort ret_sort = isBoolTy ? z3ctx.bool_sort() : z3ctx.int_sort();
-        z3::func_decl func_sig = z3ctx.function(v->getName().data(), sorts, ret_sort);
-        res = func_sig(args);
     }
-    return res.simplify();
+    return reachable;
 }
 
-z3::expr def2z3(const Value* v, const LoopInfo& LI, z3::context &z3ctx) {
-    z3::expr res(z3ctx);
-    Type* vTy = v->getType();
-    const Instruction* inst = dyn_cast<Instruction>(v);
-    const BasicBlock* bb = inst->getParent();
-    int depth = LI.getLoopDepth(bb);
-    z3::sort_vector sorts(z3ctx);
-    z3::expr_vector args(z3ctx);
-    for (int i = 0; i < depth - 1; i++) {
-        sorts.push_back(z3ctx.int_sort());
-        std::string idx = std::string("n") + std::to_string(i);
-        args.push_back(z3ctx.int_const(idx.data()));
-    }
-    if (depth > 0) {
-        sorts.push_back(z3ctx.int_sort());
-        std::string idx = std::string("n") + std::to_string(depth - 1);
-        args.push_back(z3ctx.int_const(idx.data()) + 1);
-    }
-    if (auto CI = dyn_cast<ConstantInt>(v)) {
-        bool isBoolTy = vTy->isIntegerTy(1);
-        if (isBoolTy) {
-            res = z3ctx.bool_val(*CI->getValue().getRawData() != 0);
-        } else {
-            res = z3ctx.int_val(CI->getSExtValue());
+// checks the assertions of F, which is normalized and has its memory model and
+// the summaries of its callees in place; results are reported in assertion order
+void verify_function(Function& F, FunctionAnalysisManager& fam, const std::function<void(int, const Use*, const assertion_result&)>& report) {
+    LoopInfo &LI = fam.getResult<LoopAnalysis>(F);
+    DominatorTree DT = DominatorTree(F);
+    PostDominatorTree PDT = PostDominatorTree(F);
+    std::vector<const Use*> assertions = collect_assertions(F);
+    std::string func_name = F.getName().str();
+    std::unique_ptr<interval_analysis> ai;
+    if (Intervals) {
+        ai = std::make_unique<interval_analysis>(F, LI);
+        ai->run();
+    }
+    std::map<const CallInst*, std::string> concrete_failures;
+    if (FalsifyRuns > 0) {
+        concrete_failures = concrete_executor(F, FalsifySeed).run(FalsifyRuns, FalsifyFuel);
+    }
+    auto check = [&](int i) {
+        if (ai && ai->proves(*assertions[i])) {
+            assertion_result r;
+            r.verdict = "Correct";
+            r.decided_by = "intervals";
+            return r;
+        }
+        auto failure = concrete_failures.find(cast<CallInst>(assertions[i]->getUser()));
+        if (failure != concrete_failures.end()) {
+            assertion_result r;
+            r.verdict = "Wrong";
+            r.witness = failure->second;
+            r.decided_by = "execution";
+            return r;
+        }
+        std::ofstream out("tmp/tmp" + std::to_string(i) + ".smt2");
+        assertion_result r;
+        bool exhausted = false;
+        try {
+            r = check_assertion(func_name, i, assertions[i], LI, DT, PDT, ai.get(), contexts->acquire(), out);
+        } catch (...) {
+            if (MemoryBudget == 0 || !z3_out_of_memory()) throw;
+            r.verdict = "Unknown";
+            exhausted = true;
+        }
+        out.close();
+        // the terms of the query are gone, its context may go as well
+        if (contexts->release(exhausted) && MemoryBudget > 0) trim_heap();
+        return r;
+    };
+    auto done = [&](int i, const assertion_result& r) {
+        rss.sample();
+        report(i, assertions[i], r);
+    };
+    if (Workers == 0) {
+        for (size_t i = 0; i < assertions.size(); i++) {
+            done(i, check(i));
         }
     } else {
-        bool isBoolTy = vTy->isIntegerTy(1);
-        z3::sort ret_sort = isBoolTy ? z3ctx.bool_sort() : z3ctx.int_sort();
-        z3::func_decl func_sig = z3ctx.function(v->getName().data(), sorts, ret_sort);
-        res = func_sig(args);
+        // results arrive out of order, report them in assertion order
+        std::vector<assertion_result> results(assertions.size());
+        std::vector<bool> arrived(assertions.size());
+        size_t reported = 0;
+        worker_pool pool(Workers, WorkerMemory, WorkerCPU);
+        pool.run(assertions.size(), [&](int i) {
+            return check(i).serialize();
+        }, [&](int i, const std::string& payload) {
+            results[i] = assertion_result::parse(payload);
+            arrived[i] = true;
+            while (reported < assertions.size() && arrived[reported]) {
+                done(reported, results[reported]);
+                reported++;
+            }
+        });
     }
-    return res.simplify();
 }
 
-std::vector<const Use*> collectAllAssertions(Function& f) {
-    std::vector<const Use*> assertions;
-    for (const auto& bb : f) {
-        for (const auto& inst : bb) {
-            unsigned opcode = inst.getOpcode();
-            if (opcode == Instruction::Call) {
-                auto callStmt = dyn_cast<CallInst>(&inst);
-                Function* calledFunction = callStmt->getCalledFunction();
-                StringRef funcName = calledFunction->getName();
-                if (funcName.endswith("assert")) {
-                    assertions.push_back(&callStmt->getArgOperandUse(0));
-                }
-            }
+// an input of -serve as it was verified last; the analysis managers are
+// declared after the module, so they go first
+struct resident_input {
+    LLVMContext ctx;
+    std::unique_ptr<Module> mod;
+    LoopAnalysisManager LAM;
+    FunctionAnalysisManager FAM;
+    CGSCCAnalysisManager CGAM;
+    ModuleAnalysisManager MAM;
+    std::set<Function*> reachable;
+    std::map<const Function*, std::unique_ptr<memory_model>> memory_models;
+    summary_store summaries;
+    // of the raw IR, see module_hashes
+    std::map<std::string, uint64_t> hashes;
+    // per function, the results of its assertions
+    std::map<std::string, std::vector<assertion_result>> results;
+    ~resident_input() {
+        for (Function* F : reachable) {
+            release_function(*F);
         }
     }
-    return assertions;
+};
+
+std::string result_line(const std::string& function, int i, const Use* u, bool cached, const assertion_result& r) {
+    std::string location = debug_location(u);
+    return "result\t" + function + "\t" + std::to_string(i) + "\t" + (location.empty() ? "-" : location) + "\t" + (cached ? "cached" : "checked") + "\t" + r.serialize();
 }
 
-z3::expr_vector inst2z3(const Instruction* inst, const LoopInfo& LI, const DominatorTree& DT, const PostDominatorTree& PDT, std::set<const Loop*>& loops, z3::context& z3ctx) {
-    auto opcode = inst->getOpcode();
-    z3::expr_vector res(z3ctx);
-    z3::expr cur_expr(z3ctx, z3ctx.bool_val(true));
-    static int call_index = 0;
-    if (inst->isBinaryOp()) {
-        z3::expr lhs = def2z3(inst, LI, z3ctx);
-        z3::expr operand0 = use2z3(inst->getOperandUse(0), LI, z3ctx);
-        z3::expr operand1 = use2z3(inst->getOperandUse(1), LI, z3ctx);
-        if (opcode == Instruction::Add) {
-            cur_expr = (lhs == operand0 + operand1);
-        } else if (opcode == Instruction::Sub) {
-            cur_expr = (lhs == operand0 - operand1);
-        } else if (opcode == Instruction::Mul) {
-            cur_expr = (lhs == operand0 * operand1);
-        } else if (opcode == Instruction::SRem || opcode == Instruction::URem) {
-            cur_expr = (lhs == operand0 % operand1);
+// verifies the input at path, reusing what is resident from its last version:
+// only the functions whose IR changed, or that call one that did, are checked
+// again, and only their summaries are recomputed
+void verify_resident(const std::string& path, std::map<std::string, std::unique_ptr<resident_input>>& inputs, const request_server::reply_fn& reply) {
+    auto in = std::make_unique<resident_input>();
+    SMDiagnostic Err;
+    in->mod = load_module(path, Err, in->ctx);
+    if (!in->mod) {
+        reply("error\t" + Err.getMessage().str());
+        return;
+    }
+    if (Error e = in->mod->materializeAll()) {
+        reply("error\t" + toString(std::move(e)));
+        return;
+    }
+    in->hashes = module_hashes(*in->mod);
+    PassBuilder PB;
+    PB.registerModuleAnalyses(in->MAM);
+    PB.registerCGSCCAnalyses(in->CGAM);
+    PB.registerFunctionAnalyses(in->FAM);
+    PB.registerLoopAnalyses(in->LAM);
+    PB.crossRegisterProxies(in->LAM, in->FAM, in->CGAM, in->MAM);
+    std::set<Function*> targets;
+    in->reachable = reachable_from_assertions(*in->mod, targets);
+
+    auto resident = inputs.find(path);
+    resident_input* previous = resident == inputs.end() ? nullptr : resident->second.get();
+    std::set<const Function*> stale(in->reachable.begin(), in->reachable.end());
+    if (previous) {
+        stale = stale_functions(in->reachable, in->hashes, previous->hashes);
+        // nothing is resident of the functions the last version did not reach
+        std::set<std::string> known;
+        for (Function* F : previous->reachable) {
+            known.insert(F->getName().str());
         }
-        res.push_back(cur_expr.simplify());
-    } else if (opcode == Instruction::Select) {
-        z3::expr lhs = def2z3(inst, LI, z3ctx);
-        // z3::expr pred = z3ctx.bool_const(inst->getOperand(0)->getName().data());
-        z3::expr pred = use2z3(inst->getOperandUse(0), LI, z3ctx);
-        z3::expr true_v = use2z3(inst->getOperandUse(1), LI, z3ctx);
-        z3::expr false_v = use2z3(inst->getOperandUse(2), LI, z3ctx);
-        cur_expr = (lhs == z3::ite(pred, true_v, false_v));
-        res.push_back(cur_expr.simplify());
-    } else if (opcode == Instruction::ICmp) {
-        z3::expr lhs = def2z3(inst, LI, z3ctx);
-        z3::expr operand0 = use2z3(inst->getOperandUse(0), LI, z3ctx);
-        z3::expr operand1 = use2z3(inst->getOperandUse(1), LI, z3ctx);
-        if (auto ci = dyn_cast<ICmpInst>(inst)) {
-            auto pred = ci->getPredicate();
-            if (ICmpInst::isLT(pred)) {
-                cur_expr = (lhs == operand0 < operand1);
-            } else if (ICmpInst::isLE(pred)) {
-                cur_expr = (lhs == operand0 <= operand1);
-            } else if (ICmpInst::isGT(pred)) {
-                cur_expr = (lhs == operand0 > operand1);
-            } else if (ICmpInst::isGE(pred)) {
-                cur_expr = (lhs == operand0 >= operand1);
-            } else if (ICmpInst::isEquality(pred)) {
-                cur_expr = (lhs == (operand0 == operand1));
-            }
+        for (Function* F : in->reachable) {
+            if (!known.count(F->getName().str())) stale.insert(F);
         }
-        res.push_back(cur_expr.simplify());
-    } else if (opcode == Instruction::PHI) {
-        assert(inst->getType()->isIntegerTy());
-        const PHINode* PN = dyn_cast<PHINode>(inst);
-        const BasicBlock* bb = inst->getParent();
-        int depth = LI.getLoopDepth(bb);
-        z3::sort_vector sorts(z3ctx);
-        z3::expr_vector args_0(z3ctx);
-        z3::expr_vector args_N(z3ctx);
-        z3::expr_vector args_n_1(z3ctx);
-        for (int i = 0; i < depth - 1; i++) {
-            std::string idx = std::string("n") + std::to_string(i);
-            sorts.push_back(z3ctx.int_sort());
-            args_0.push_back(z3ctx.int_const(idx.data()));
-            args_N.push_back(z3ctx.int_const(idx.data()));
-            args_n_1.push_back(z3ctx.int_const(idx.data()));
+    }
+    unsigned checked = 0;
+    unsigned cached = 0;
+    for (Function* F : in->reachable) {
+        normalize(*F, in->FAM);
+    }
+    std::set<Function*> fresh;
+    for (Function* F : in->reachable) {
+        if (!stale.count(F)) continue;
+        fresh.insert(F);
+        if (MemoryModel) {
+            auto model = std::make_unique<memory_model>(*F, in->FAM.getResult<MemorySSAAnalysis>(*F).getMSSA(), in->FAM.getResult<AAManager>(*F));
+            set_memory_model(*F, model.get());
+            in->memory_models.emplace(F, std::move(model));
         }
-        if (depth > 0) {
-            sorts.push_back(z3ctx.int_sort());
-            args_0.push_back(z3ctx.int_val(0));
-            std::string N = std::string("N") + std::to_string(depth - 1);
-            args_N.push_back(z3ctx.int_const(N.data()));
-            std::string idx = std::string("n") + std::to_string(depth - 1);
-            args_n_1.push_back(z3ctx.int_const(idx.data()) + 1);
+    }
+    set_call_summaries(Summaries ? &in->summaries : nullptr);
+    if (Summaries) {
+        // the callees of a fresh function are fresh or have the IR they were summarized with
+        for (Function* F : in->reachable) {
+            if (!fresh.count(F)) in->summaries.adopt(previous->summaries, *previous->mod->getFunction(F->getName()), *F);
         }
-        z3::func_decl func_sig = z3::function(inst->getName().data(), sorts, z3ctx.int_sort());
-        for (int i = 0; i < PN->getNumIncomingValues(); i++) {
-            const Use& incoming_u = PN->getOperandUse(i);
-            const BasicBlock* incoming_b = PN->getIncomingBlock(i);
-            if (depth > LI.getLoopDepth(incoming_b)) { // initial values
-                cur_expr = (func_sig(args_0) == use2z3(incoming_u, LI, z3ctx));
-            } else if (depth == LI.getLoopDepth(incoming_b)) {
-                const Loop* someLoop = LI.getLoopFor(incoming_b);
-                if (someLoop) { // inductive values
-                    bool from_latch = someLoop->isLoopLatch(incoming_b);
-                    cur_expr = (def2z3(inst, LI, z3ctx) == use2z3(incoming_u, LI, z3ctx, from_latch));
-                } else { // 
-                    cur_expr = (def2z3(inst, LI, z3ctx) == use2z3(incoming_u, LI, z3ctx));
-                }
-            } else {
-                cur_expr = (def2z3(inst, LI, z3ctx) == use2z3(incoming_u, LI, z3ctx));
+        in->summaries.compute(*in->mod, in->MAM, fresh, SummaryThreads);
+    }
+
+    bool connected = true;
+    auto &fam = in->MAM.getResult<FunctionAnalysisManagerModuleProxy>(*in->mod).getManager();
+    for (Function& F : *in->mod) {
+        if (!targets.count(&F)) continue;
+        std::string func_name = F.getName().str();
+        std::vector<assertion_result>& results = in->results[func_name];
+        if (!fresh.count(&F)) {
+            results = previous->results.at(func_name);
+            std::vector<const Use*> assertions = collect_assertions(F);
+            for (size_t i = 0; i < results.size() && connected; i++) {
+                connected = reply(result_line(func_name, i, assertions[i], true, results[i]));
+                cached++;
             }
-            res.push_back(cur_expr.simplify());
+            continue;
         }
+        verify_function(F, fam, [&](int i, const Use* u, const assertion_result& r) {
+            results.push_back(r);
+            checked++;
+            // the results are kept for the next request even if this client is gone
+            if (connected) connected = reply(result_line(func_name, i, u, false, r));
+        });
     }
-    z3::expr_vector globally_quantified(z3ctx);
-    int depth = LI.getLoopDepth(inst->getParent());
-    z3::expr_vector ret(z3ctx);
-    for (int i = 0; i < depth; i++) {
-        std::string name = std::string("n") + std::to_string(i);
-        z3::expr n = z3ctx.int_const(name.data());
-        globally_quantified.push_back(n);
+    // nothing is encoded again until the next version, which brings its own functions
+    for (Function* F : in->reachable) {
+        release_function(*F);
     }
-    for (int i = 0; i < res.size(); i++) {
-        if (depth > 0) {
-            const Loop* loop = LI.getLoopFor(inst->getParent());
-            ret.push_back(z3::forall(globally_quantified, res[i]).simplify());
-            // loops.insert(loop);
-        } else {
-            ret.push_back(res[i].simplify());
-        }
-    }
-    return ret;
+    in->memory_models.clear();
+    inputs[path] = std::move(in);
+    if (connected) reply("done\t" + std::to_string(checked) + "\t" + std::to_string(cached));
 }
 
-
-
-z3::expr_vector rel2z3(const Value* v, std::vector<const Value*>& visited, const LoopInfo& LI, const DominatorTree& DT, const PostDominatorTree& PDT, std::set<const Loop*>& loops, std::map<Value*, z3::expr_vector>& cached, z3::context& z3ctx) {
-    z3::expr_vector res(z3ctx);
-    // errs() << v->getName() << "\n";
-    if (std::find(visited.begin(), visited.end(), v) != visited.end()) {
-        return res;
-    }
-    visited.push_back(v);
-    if (auto inst = dyn_cast<Instruction>(v) ) {
-        if (const Loop* loop = LI.getLoopFor(inst->getParent())) {
-            if (loops.find(loop) == loops.end()) {
-                loops.insert(loop);
-                z3::expr_vector loop_ret = handle_loop(loop, visited, LI, DT, PDT, loops, cached, z3ctx);
-                combine_vec(res, loop_ret);
-            }
-            std::map<z3::expr, z3::expr> closed_form = solve_rec(v, LI, z3ctx);
-            // auto keys_values = map2expr_vector(closed_form, z3ctx);
-            z3::expr as_header_phi = eliminate_tmp(v, loop, z3ctx);
-            if (closed_form.size() != 0) {
-                z3::expr inv_var = z3ctx.int_const("n0");
-                for (auto &i : closed_form) {
-                    res.push_back(z3::forall(inv_var, z3::implies(inv_var >= 0, i.first == i.second)));
-                }
-                std::set<const PHINode*> phis;
-                find_phi_in_header(v, loop, LI, phis);
-                for (auto phi : phis) {
-                    for (int i = 0; i < phi->getNumIncomingValues(); i++) {
-                        if (!loop->contains(phi->getIncomingBlock(i))) {
-                            z3::expr_vector operand_expr_vec = rel2z3(phi->getIncomingValue(i), visited, LI, DT, PDT, loops, cached, z3ctx);
-                            combine_vec(res, operand_expr_vec);
-                        }
-                    }
-                return res;
-                }
-            }
+// c2z3 -serve: requests are "check\t<absolute path>", answered with a
+// "result\t<function>\t<index>\t<location>\t<checked|cached>\t<result>" line per
+// assertion and "done\t<checked>\t<cached>", or with "error\t<message>";
+// "shutdown" stops the daemon
+int serve_requests(const std::string& socket) {
+    request_server server(socket);
+    if (!server.enabled()) return 1;
+    std::map<std::string, std::unique_ptr<resident_input>> inputs;
+    // the paths of the resident inputs, least recently checked first
+    std::deque<std::string> recent;
+    server.serve([&](const std::string& request, const request_server::reply_fn& reply) {
+        StringRef command, path;
+        std::tie(command, path) = StringRef(request).split('\t');
+        if (command == "shutdown") {
+            reply("done\t0\t0");
+            return false;
         }
-        unsigned opcode = inst->getOpcode();
-        if (opcode == Instruction::Call) {
-            return res;
+        if (command != "check" || path.empty()) {
+            reply("error\tunknown request " + request);
+            return true;
         }
-        if (opcode == Instruction::PHI) {
-            const PHINode* phi = dyn_cast<PHINode>(inst);
-            if (phi->getNumIncomingValues() == 2) {
-                IRBuilder<> builder(v->getContext());
-                const BasicBlock* curB = phi->getParent();
-                const BasicBlock* bb0 = phi->getIncomingBlock(0);
-                const BasicBlock* bb1 = phi->getIncomingBlock(1);
-                const BasicBlock* domB = DT.findNearestCommonDominator(bb0, bb1);
-                if (PDT.dominates(curB, domB)) {
-                    const Instruction* term = domB->getTerminator();
-                    const BranchInst* branch = dyn_cast<BranchInst>(term);
-                    if (branch && branch->isConditional()) {
-                        Value* condV = branch->getCondition();
-                        const BasicBlock* true_b = bb0;
-                        const BasicBlock* false_b = bb1;
-                        if (DT.dominates(branch->getSuccessor(0), bb0) || DT.dominates(branch->getSuccessor(1), bb1)) {
-                            true_b = bb0;
-                            false_b = bb1;
-                        } else {
-                            true_b = bb1;
-                            false_b = bb0;
-                        }
-                        int true_idx = phi->getBasicBlockIndex(true_b);
-                        int false_idx = phi->getBasicBlockIndex(false_b);
-                        Value* new_select = builder.CreateSelect(condV, phi->getIncomingValue(true_idx), phi->getIncomingValue(false_idx));
-                        new_select->setName(v->getName());
-                        inst = dyn_cast<Instruction>(new_select);
-                    }
-                }
-            }
+        try {
+            verify_resident(path.str(), inputs, reply);
+        } catch (const encoding_error& e) {
+            // what was resident of the input stays as it was
+            reply(std::string("error\t") + e.what());
+        } catch (const z3::exception& e) {
+            reply(std::string("error\t") + e.msg());
         }
-        z3::expr_vector cur_expr_vec = inst2z3(inst, LI, DT, PDT, loops, z3ctx);
-        combine_vec(res, cur_expr_vec);
-        // res.push_back(cur_expr);
-        for (const Use& u : inst->operands()) {
-            const Value* operand_v = u.get();
-            z3::expr_vector operand_expr_vec = rel2z3(operand_v, visited, LI, DT, PDT, loops, cached, z3ctx);
-            combine_vec(res, operand_expr_vec);
+        recent.erase(std::remove(recent.begin(), recent.end(), path.str()), recent.end());
+        recent.push_back(path.str());
+        if (MemoryBudget > 0) {
+            // over the budget, the inputs checked longest ago are verified from scratch next time
+            while (recent.size() > 1 && current_rss_mb() > MemoryBudget) {
+                inputs.erase(recent.front());
+                recent.pop_front();
+                trim_heap();
+            }
+            rss.report(errs());
         }
-    }
-    return res;
+        return true;
+    });
+    set_call_summaries(nullptr);
+    return 0;
 }
 
-z3::expr_vector handle_loop(const Loop* loop, std::vector<const Value*>& visited, const LoopInfo& LI, const DominatorTree& DT, const PostDominatorTree& PDT, std::set<const Loop*> loops, std::map<Value*, z3::expr_vector>& cached, z3::context& z3ctx) {
-    z3::expr_vector res(z3ctx);
-    SmallVector<BasicBlock*> exitingBBs;
-    loop->getExitingBlocks(exitingBBs);
-    // z3::expr_vector exitConds(z3ctx);
-    std::vector<const Value*> exitConds;
-    std::vector<bool> true_or_false;
-    for (const auto bb : exitingBBs) {
-        const Instruction* terminator = bb->getTerminator();
-        if (auto CI = dyn_cast<BranchInst>(terminator)) {
-            assert(CI->isConditional());
-            const Value* cond = CI->getCondition();
-            exitConds.push_back(cond);
-            z3::expr_vector conds = rel2z3(cond, visited, LI, DT, PDT, loops, cached, z3ctx);
-            combine_vec(res, conds);
-            assert(CI->getNumSuccessors() == 2);
-            const BasicBlock* succ = CI->getSuccessor(0);
-            true_or_false.push_back(!loop->contains(succ));
-        } else {
-            errs() << "Unexpected Loop\n";
-            exit(0);
+// c2z3 -connect: the daemon verifies the input, the results are printed as if it was checked here
+int request_verification(const std::string& socket, const std::string& input) {
+    SmallString<256> abs_path(input);
+    sys::fs::make_absolute(abs_path);
+    result_stream results(JSONOutput);
+    bool done = false;
+    bool reached = send_request(socket, "check\t" + abs_path.str().str(), [&](const std::string& line) {
+        SmallVector<StringRef, 6> fields;
+        StringRef(line).split(fields, '\t');
+        if (fields[0] == "error" && fields.size() > 1) {
+            errs() << "c2z3: " << fields[1] << "\n";
+        } else if (fields[0] == "done") {
+            done = true;
+        } else if (fields[0] == "result" && fields.size() == 6) {
+            assertion_result r = assertion_result::parse(fields[5].str());
+            errs() << r.verdict << "\n";
+            int index = 0;
+            fields[2].getAsInteger(10, index);
+            results.write(fields[1].str(), index, fields[3] == "-" ? "" : fields[3].str(), r);
         }
+    });
+    if (!reached) {
+        errs() << "c2z3: no daemon listening on " << socket << "\n";
+        return 1;
     }
-    int depth = loop->getLoopDepth();
-    std::string N_name = std::string("N") + std::to_string(depth - 1);
-    z3::expr N = z3ctx.int_const(N_name.data());
-    z3::expr_vector args_in(z3ctx);
-    z3::expr_vector args_out(z3ctx);
-    z3::sort_vector param(z3ctx);
-    for (int j = 0; j < depth - 1; j++) {
-        param.push_back(z3ctx.int_sort());
-        std::string n_name = std::string("n") + std::to_string(j);
-        args_out.push_back(z3ctx.int_const(n_name.data()));
-    }
-    param.push_back(z3ctx.int_sort());
-    args_out.push_back(N);
-    std::string last_n_name = std::string("n") + std::to_string(depth - 1);
-    args_in.push_back(z3ctx.int_const(last_n_name.data()));
-
-    z3::expr_vector funcs_in_loop(z3ctx);
-    z3::expr_vector funcs_out_loop(z3ctx);
-    z3::expr final_out_cond(z3ctx.bool_val(false));
-    z3::expr final_in_cond(z3ctx.bool_val(true));
-    for (int i = 0; i < exitConds.size(); i++) {
-        z3::func_decl func = z3ctx.function(exitConds[i]->getName().data(), param, z3ctx.bool_sort());
-        // funcs_in_loop.push_back(func(args_in));
-        // funcs_out_loop.push_back(func(args_out));
-        final_out_cond = final_out_cond || (true_or_false[i] ? func(args_out) : !func(args_out));
-        final_in_cond = final_in_cond && !(true_or_false[i] ? func(args_in) : !func(args_in));
-    }
-
-    res.push_back(final_out_cond.simplify());
-    final_in_cond = z3::forall(args_in, z3::implies(args_in.back() < args_out.back() && args_in.back() >= 0, final_in_cond));
-    res.push_back(final_in_cond.simplify());
-    res.push_back(args_out.back() >= 0);
-    return res;
+    return done ? 0 : 1;
 }
 
-z3::expr path_condition(const BasicBlock* bb, const LoopInfo& LI, z3::context& z3ctx) {
-    z3::expr res(z3ctx, z3ctx.bool_val(false));
-    const BasicBlock* entry = &(bb->getParent()->getEntryBlock());
-    if (bb == entry) return z3ctx.bool_val(true);
-    for (auto pred_pp = pred_begin(bb); pred_pp != pred_end(bb); pred_pp++) {
-        z3::expr cur_expr(z3ctx, z3ctx.bool_val(true));
-        const BasicBlock* pred = *pred_pp;
-        Loop* loop = LI.getLoopFor(bb);
-        if (loop && LI.isLoopHeader(bb) && loop->contains(pred) && loop->isLoopLatch(pred)) continue;
-        const Instruction* term = pred->getTerminator();
-        const BranchInst* br = dyn_cast<BranchInst>(term);
-        if (br->isConditional()) {
-            int idx = 0;
-            for (idx = 0; idx < term->getNumSuccessors(); idx++) {
-                if (bb == term->getSuccessor(idx)) {
-                    break;
-                }
-            }
-            cur_expr = use2z3(br->getOperandUse(0), LI, z3ctx, false, true);
-            if (idx == 1) {
-                cur_expr = !cur_expr;
-            }
+int main(int argc, char** argv) {
+    cl::HideUnrelatedOptions(C2Z3Category);
+    cl::ParseCommandLineOptions(argc, argv, "c2z3: verify assertions of LLVM IR with Z3\n");
+    if (Serve.empty() && InputFilename.empty()) {
+        errs() << "c2z3: no input file\n";
+        return 1;
+    }
+    if (!Connect.empty()) return request_verification(Connect, InputFilename);
+    if (!Z3Config.empty()) {
+        if (!z3_config.load(Z3Config)) return 1;
+        z3_config.install();
+    }
+    set_simplification(Simplify == simplify_eager);
+    std::vector<std::unique_ptr<solver_backend>> backends;
+    for (const std::string& spec : Solvers) {
+        // the Z3 backend solves in the query's own context, only one thread may
+        if (spec == "z3" && std::count(Solvers.begin(), Solvers.end(), spec) > 1) {
+            errs() << "c2z3: -solver=z3 may be given only once\n";
+            return 1;
         }
-        z3::expr pred_cond = path_condition(pred, LI, z3ctx);
-        res = res || (pred_cond && cur_expr);
+        backends.push_back(make_backend(spec));
     }
-    return res;
-}
-
-void check_assertion(const Use* u, const LoopInfo& LI, const DominatorTree& DT, const PostDominatorTree& PDT, std::ofstream& out) {
-    // const Instruction* defInst = dyn_cast<const Instruction>(v);
-    z3::context z3ctx;
-    z3::solver solver(z3ctx);
-    // solver.add(z3ctx.int_const("N0") == z3ctx.int_const("%i") || z3ctx.int_const("%i") < 0);
-    // solver.add(z3ctx.int_const("N0") == 0);
-    solver.add(!use2z3(*u, LI, z3ctx));
-    Value* v = u->get();
-    Instruction* user = dyn_cast<Instruction>(u->getUser());
-    const BasicBlock* assert_block = user->getParent();
-    // errs() << path_condition(assert_block, LI, z3ctx).simplify().to_string() << "\n";
-    std::vector<const Value*> visited;
-    std::set<const Loop*> loops;
-    std::map<Value*, z3::expr_vector> cached;
-    z3::expr_vector all_z3 = rel2z3(v, visited, LI, DT, PDT, loops, cached, z3ctx);
-    z3::expr path_cond = path_condition(assert_block, LI, z3ctx);
-    solver.add(all_z3);
-    solver.add(path_cond);
-    out << solver.to_smt2();
-    z3::params p(z3ctx);
-    p.set(":timeout", 3000u);
-    solver.set(p);
-    switch (solver.check()) {
-        case z3::sat: errs() << "Wrong\n"; break;
-        case z3::unsat: errs() << "Correct\n"; break;
-        default: errs() << "Unknown\n"; break;
+    if (backends.empty()) {
+        backend = make_backend("z3");
+    } else if (backends.size() == 1) {
+        backend = std::move(backends.front());
+    } else {
+        backend = std::make_unique<racing_backend>(std::move(backends));
     }
-}
-
-void test_solver() {
-    z3::context zctx;
-    z3::func_decl func = zctx.function("f", zctx.int_sort(), zctx.int_sort());
-    z3::expr n = zctx.int_const("n");
-    std::map<z3::expr, z3::expr> eqs;
-    eqs.insert_or_assign(func(n+1), 3*func(n) + 2);
-    rec_solver s(eqs, n, zctx);
-    s.simple_solve();
-    for (auto &i : s.get_res()) {
-        errs() << i.first.to_string() << " = " << i.second.to_string() << "\n";
+    if (Simplify == simplify_deferred) {
+        // tuned preprocessing runs after the simplification
+        std::string tuned = z3_config.get(solver_config::preprocess_key);
+        z3_config.set(solver_config::preprocess_key, tuned.empty() ? Preprocess : Preprocess + "," + tuned);
     }
-    exit(0);
-}
-
-int main(int argc, char** argv) {
+    if (MemoryBudget > 0 && MemoryBudget < context_pool::min_budget_mb) {
+        errs() << "c2z3: -memory-budget must be at least " << context_pool::min_budget_mb << " MB\n";
+        return 1;
+    }
+    contexts = std::make_unique<context_pool>(ContextQueries, MemoryBudget);
+    recorder = std::make_unique<query_log>(Record);
+    if (!Record.empty() && !recorder->enabled()) return 1;
+    if (!Serve.empty()) return serve_requests(Serve);
     LLVMContext ctx;
     SMDiagnostic Err;
-    std::unique_ptr<Module> mod(parseIRFile(argv[1], Err, ctx));
+    std::unique_ptr<ir_cache> cache;
+    std::unique_ptr<Module> mod;
+    if (!CacheDir.empty()) {
+        auto contents = MemoryBuffer::getFile(InputFilename);
+        if (contents) {
+            cache = std::make_unique<ir_cache>(CacheDir, InputFilename, (*contents)->getBuffer(), entry_functions());
+            // a C file's module also depends on its headers and the -Xcc flags, so
+            // it is compiled every time and only its functions come from the cache,
+            // by the hash of their freshly compiled IR
+            if (!StringRef(InputFilename).endswith(".c")) mod = cache->load_unchanged(ctx);
+        }
+    }
+    if (!mod) {
+        mod = load_module(InputFilename, Err, ctx);
+    }
+    if (!mod) {
+        Err.print(argv[0], errs());
+        return 1;
+    }
 
     PassBuilder PB;
     LoopAnalysisManager LAM;
@@ -670,37 +691,61 @@ int main(int argc, char** argv) {
     PB.registerLoopAnalyses(LAM);
     PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
 
-    ModulePassManager MPM;
-    MPM.addPass(createModuleToFunctionPassAdaptor(PromotePass()));
-    MPM.addPass(createModuleToFunctionPassAdaptor(LCSSAPass()));
-    MPM.addPass(createModuleToFunctionPassAdaptor(SimplifyCFGPass()));
-    MPM.addPass(createModuleToFunctionPassAdaptor(LoopSimplifyPass()));
-    MPM.addPass(createModuleToFunctionPassAdaptor(InstructionNamerPass()));
-    MPM.addPass(createModuleToFunctionPassAdaptor(AggressiveInstCombinePass()));
-    MPM.run(*mod, MAM);
+    // only functions an assertion can reach are normalized (and, for bitcode, loaded at all)
+    std::set<Function*> targets;
+    std::set<Function*> reachable = reachable_from_assertions(*mod, targets);
+    bool cache_changed = false;
+    for (Function* F : reachable) {
+        if (!cache) {
+            normalize(*F, FAM);
+            continue;
+        }
+        if (cache->is_normalized(*F)) continue;
+        uint64_t raw_hash = ir_cache::function_hash(*F);
+        if (!cache->reuse(*F, raw_hash, ctx)) {
+            normalize(*F, FAM);
+        }
+        cache->record(*F, raw_hash);
+        cache_changed = true;
+    }
+    if (cache_changed) {
+        cache->store(*mod);
+    }
+
+    std::map<const Function*, std::unique_ptr<memory_model>> memory_models;
+    if (MemoryModel) {
+        for (Function* F : reachable) {
+            auto model = std::make_unique<memory_model>(*F, FAM.getResult<MemorySSAAnalysis>(*F).getMSSA(), FAM.getResult<AAManager>(*F));
+            set_memory_model(*F, model.get());
+            memory_models.emplace(F, std::move(model));
+        }
+    }
+
+    summary_store summaries;
+    if (Summaries) {
+        // callers are summarized with the summaries of their callees
+        set_call_summaries(&summaries);
+        summaries.compute(*mod, MAM, reachable, SummaryThreads);
+    }
 
 
     std::error_code ec;
     raw_fd_ostream output_fd("tmp/tmp.ll", ec);
     mod->print(output_fd, NULL);
     output_fd.close();
-    z3::context z3ctx;
+    result_stream results(JSONOutput);
+    auto &fam = MAM.getResult<FunctionAnalysisManagerModuleProxy>(*mod).getManager();
     for (auto F = mod->begin(); F != mod->end(); F++) {
-        if (F->getName() == "main") {
-    //         z3::expr_vector assertions(z3ctx);
-            auto &fam = MAM.getResult<FunctionAnalysisManagerModuleProxy>(*mod).getManager();
-            LoopInfo &LI = fam.getResult<LoopAnalysis>(*F);
-            DominatorTree DT = DominatorTree(*F);
-            PostDominatorTree PDT = PostDominatorTree(*F);
-    //         // std::vector<BBPath> allPaths = pathsFromEntry2Exit(&F->getEntryBlock(), LI);
-            // z3::expr_vector assertions(z3ctx);
-            std::vector<const Use*> assertions = collectAllAssertions(*F);
-            int i = 0;
-            for (auto a : assertions) {
-                std::ofstream out("tmp/tmp" + std::to_string(i) + ".smt2");
-                check_assertion(a, LI, DT, PDT, out);
-                out.close();
-            }
+        if (targets.count(&*F)) {
+            std::string func_name = F->getName().str();
+            verify_function(*F, fam, [&](int i, const Use* u, const assertion_result& r) {
+                errs() << r.verdict << "\n";
+                results.write(func_name, i, debug_location(u), r);
+            });
+            // callers are encoded with F's summary, nothing of F is encoded again
+            release_function(*F);
+            memory_models.erase(&*F);
         }
     }
+    if (MemoryBudget > 0) rss.report(errs());
 }
@@ -0,0 +1,104 @@
+#include "memory_budget.h"
+#include <sys/resource.h>
+#include <unistd.h>
+#include <cxxabi.h>
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <typeinfo>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+double current_rss_mb() {
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (!statm) return 0;
+    long pages = 0;
+    long resident = 0;
+    int read = fscanf(statm, "%ld %ld", &pages, &resident);
+    fclose(statm);
+    if (read != 2) return 0;
+    return (double)resident * sysconf(_SC_PAGESIZE) / (1 << 20);
+}
+
+double peak_rss_mb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    // in KB on Linux
+    return usage.ru_maxrss / 1024.0;
+}
+
+void trim_heap() {
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+}
+
+bool z3_out_of_memory() {
+    try {
+        throw;
+    } catch (const z3::exception& e) {
+        // Z3_MEMOUT_FAIL
+        return std::string(e.msg()) == "out of memory";
+    } catch (...) {
+        // not part of Z3's API, known by name only
+        const std::type_info* type = abi::__cxa_current_exception_type();
+        return type && std::string(type->name()).find("out_of_memory_error") != std::string::npos;
+    }
+}
+
+static void cap_z3_memory(unsigned mb) {
+    z3::set_param("memory_max_size", std::to_string(mb).data());
+}
+
+context_pool::context_pool(unsigned queries, unsigned budget_mb): queries(queries), budget_mb(budget_mb), used(0) {
+    if (budget_mb > 0) cap_z3_memory(budget_mb);
+}
+
+z3::context& context_pool::acquire() {
+    if (!ctx) {
+        ctx = std::make_unique<z3::context>();
+        used = 0;
+    }
+    return *ctx;
+}
+
+bool context_pool::release(bool exhausted) {
+    used++;
+    if (!exhausted && (queries == 0 || used < queries)) return false;
+    if (!exhausted || budget_mb == 0) {
+        ctx.reset();
+        return true;
+    }
+    // tearing a context down allocates, which fails while Z3 is still over the cap
+    cap_z3_memory(0);
+    ctx.reset();
+    // Z3 does not give back everything it held when it ran out; the next
+    // queries get the whole budget on top of what it still holds, without room
+    // even a fresh context could not be created
+    unsigned held_mb = Z3_get_estimated_alloc_size() >> 20;
+    cap_z3_memory(budget_mb + held_mb);
+    return true;
+}
+
+void rss_monitor::sample() {
+    samples.push_back(current_rss_mb());
+}
+
+double rss_monitor::steady_mb() const {
+    if (samples.empty()) return current_rss_mb();
+    std::vector<double> later(samples.begin() + samples.size() / 2, samples.end());
+    std::sort(later.begin(), later.end());
+    return later[later.size() / 2];
+}
+
+void rss_monitor::report(llvm::raw_ostream& os) const {
+    // ru_maxrss and statm are read at different times and rounded differently
+    double peak = peak_rss_mb();
+    for (double mb : samples) {
+        peak = std::max(peak, mb);
+    }
+    char line[128];
+    snprintf(line, sizeof(line), "c2z3: peak RSS %.1f MB, steady-state RSS %.1f MB over %zu assertions\n", peak, steady_mb(), samples.size());
+    os << line;
+}
@@ -0,0 +1,141 @@
+#include "llvm/Analysis/MemoryLocation.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/InstIterator.h"
+
+#include "memory_model.h"
+
+using namespace llvm;
+
+unsigned memory_model::node(const Value* object) {
+    auto it = object_id.find(object);
+    if (it != object_id.end()) return it->second;
+    unsigned id = objects.size();
+    object_id.emplace(object, id);
+    objects.push_back(object);
+    parent.push_back(id);
+    opaque.push_back(false);
+    return id;
+}
+
+unsigned memory_model::find(unsigned id) {
+    while (parent[id] != id) {
+        parent[id] = parent[parent[id]];
+        id = parent[id];
+    }
+    return id;
+}
+
+void memory_model::unite(unsigned a, unsigned b) {
+    a = find(a);
+    b = find(b);
+    if (a == b) return;
+    parent[b] = a;
+    // offsets relative to different objects cannot share one array
+    opaque[a] = true;
+}
+
+std::string memory_model::partition_name(unsigned p) const {
+    if (objects[p]->hasName()) return objects[p]->getName().str();
+    return "mem" + std::to_string(p);
+}
+
+const memory_version* memory_model::version(MemoryAccess* access, unsigned p, MemorySSA& MSSA) {
+    access = MSSA.getWalker()->getClobberingMemoryAccess(access, MemoryLocation::getBeforeOrAfter(objects[p]));
+    if (MSSA.isLiveOnEntryDef(access)) {
+        auto init = initial_version.find(p);
+        if (init != initial_version.end()) return init->second;
+        const BasicBlock* entry = &access->getBlock()->getParent()->getEntryBlock();
+        versions.push_back(memory_version{memory_version::initial, "M." + partition_name(p), entry, nullptr, nullptr, {}});
+        initial_version.emplace(p, &versions.back());
+        return &versions.back();
+    }
+    auto known = version_of.find(std::make_pair(access, p));
+    if (known != version_of.end()) return known->second;
+
+    versions.push_back(memory_version{memory_version::havoc, "", access->getBlock(), nullptr, nullptr, {}});
+    memory_version* v = &versions.back();
+    version_of.emplace(std::make_pair(access, p), v);
+    if (auto def = dyn_cast<MemoryDef>(access)) {
+        v->name = "M." + partition_name(p) + "." + std::to_string(counter++);
+        auto store = dyn_cast_or_null<StoreInst>(def->getMemoryInst());
+        auto object = store ? access_object.find(store) : access_object.end();
+        if (object != access_object.end() && find(object->second) == p) {
+            v->kind = memory_version::stored;
+            v->store = store;
+            v->prev = version(def->getDefiningAccess(), p, MSSA);
+        }
+        // anything else that may write the partition (calls) leaves it unconstrained
+    } else if (auto phi = dyn_cast<MemoryPhi>(access)) {
+        v->kind = memory_version::merged;
+        v->name = "M." + partition_name(p) + "." + phi->getBlock()->getName().str();
+        for (unsigned i = 0; i < phi->getNumIncomingValues(); i++) {
+            const memory_version* in = version(phi->getIncomingValue(i), p, MSSA);
+            v->incoming.emplace_back(phi->getIncomingBlock(i), in);
+        }
+    }
+    return v;
+}
+
+memory_model::memory_model(Function& F, MemorySSA& MSSA, AAResults& AA): counter(0) {
+    std::vector<Instruction*> accesses;
+    for (Instruction& inst : instructions(F)) {
+        if (!isa<LoadInst>(inst) && !isa<StoreInst>(inst)) continue;
+        SmallVector<const Value*, 4> objs;
+        getUnderlyingObjects(getLoadStorePointerOperand(&inst), objs);
+        unsigned first = node(objs[0]);
+        for (const Value* o : objs) {
+            unite(first, node(o));
+        }
+        accesses.push_back(&inst);
+        access_object[&inst] = first;
+    }
+    // objects alias analysis cannot tell apart share a partition
+    for (unsigned i = 0; i < objects.size(); i++) {
+        for (unsigned j = i + 1; j < objects.size(); j++) {
+            if (AA.alias(MemoryLocation::getBeforeOrAfter(objects[i]), MemoryLocation::getBeforeOrAfter(objects[j])) != AliasResult::NoAlias) {
+                unite(i, j);
+            }
+        }
+    }
+    // one integer type per partition, the arrays hold Ints
+    std::map<unsigned, Type*> element;
+    for (Instruction* inst : accesses) {
+        unsigned p = find(access_object[inst]);
+        Type* ty = getLoadStoreType(inst);
+        auto known = element.find(p);
+        if (!ty->isIntegerTy() || ty->isIntegerTy(1) || (known != element.end() && known->second != ty)) {
+            opaque[p] = true;
+        }
+        element.emplace(p, ty);
+    }
+
+    for (Instruction* inst : accesses) {
+        unsigned p = find(access_object[inst]);
+        MemoryUseOrDef* access = MSSA.getMemoryAccess(inst);
+        if (opaque[p] || !access) continue;
+        if (auto load = dyn_cast<LoadInst>(inst)) {
+            reaching.emplace(load, version(access->getDefiningAccess(), p, MSSA));
+        } else {
+            const memory_version* v = version(access, p, MSSA);
+            if (v->store == inst) stored.emplace(v->store, v);
+        }
+    }
+}
+
+const memory_version* memory_model::load_version(const LoadInst* load) const {
+    auto it = reaching.find(load);
+    return it == reaching.end() ? nullptr : it->second;
+}
+
+const memory_version* memory_model::store_version(const StoreInst* store) const {
+    auto it = stored.find(store);
+    return it == stored.end() ? nullptr : it->second;
+}
+
+unsigned memory_model::num_partitions() const {
+    unsigned n = 0;
+    for (unsigned i = 0; i < objects.size(); i++) {
+        if (parent[i] == i && !opaque[i]) n++;
+    }
+    return n;
+}
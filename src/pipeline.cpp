@@ -0,0 +1,41 @@
+#include "llvm/IR/Instructions.h"
+#include "llvm/Transforms/Utils/LoopSimplify.h"
+#include "llvm/Transforms/Utils/LCSSA.h"
+#include "llvm/Transforms/Utils/Mem2Reg.h"
+#include "llvm/Transforms/Utils/InstructionNamer.h"
+#include "llvm/Transforms/Scalar/SimplifyCFG.h"
+#include "llvm/Transforms/AggressiveInstCombine/AggressiveInstCombine.h"
+
+#include "pipeline.h"
+
+using namespace llvm;
+
+std::vector<const Use*> collect_assertions(Function& f) {
+    std::vector<const Use*> assertions;
+    for (const auto& bb : f) {
+        for (const auto& inst : bb) {
+            unsigned opcode = inst.getOpcode();
+            if (opcode == Instruction::Call) {
+                auto callStmt = dyn_cast<CallInst>(&inst);
+                Function* calledFunction = callStmt->getCalledFunction();
+                if (!calledFunction) continue;
+                StringRef funcName = calledFunction->getName();
+                if (funcName.endswith("assert")) {
+                    assertions.push_back(&callStmt->getArgOperandUse(0));
+                }
+            }
+        }
+    }
+    return assertions;
+}
+
+void normalize(Function& F, FunctionAnalysisManager& FAM) {
+    FunctionPassManager FPM;
+    FPM.addPass(PromotePass());
+    FPM.addPass(LCSSAPass());
+    FPM.addPass(SimplifyCFGPass());
+    FPM.addPass(LoopSimplifyPass());
+    FPM.addPass(InstructionNamerPass());
+    FPM.addPass(AggressiveInstCombinePass());
+    FPM.run(F, FAM);
+}
@@ -0,0 +1,94 @@
+#include "query_log.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+
+// names end up in a tab-separated line
+static std::string field(const std::string& s) {
+    std::string res = s;
+    for (char& c : res) {
+        if (c == '\t' || c == '\n') c = ' ';
+    }
+    return res.empty() ? "-" : res;
+}
+
+query_log::query_log(const std::string& path): fd(-1) {
+    if (path.empty()) return;
+    fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) llvm::errs() << "c2z3: cannot open query log " << path << "\n";
+}
+
+query_log::~query_log() {
+    if (fd >= 0) close(fd);
+}
+
+bool query_log::enabled() const {
+    return fd >= 0;
+}
+
+void query_log::append(const query_record& r) {
+    if (fd < 0) return;
+    std::ostringstream os;
+    os << "query\t" << field(r.function) << "\t" << r.assertion << "\t" << field(r.backend) << "\t" << r.timeout_ms
+       << "\t" << r.result << "\t" << r.solve_ms << "\t" << r.config.size() << "\t" << r.smt2.size() << "\n"
+       << r.config << r.smt2 << "\n";
+    std::string record = os.str();
+    flock(fd, LOCK_EX);
+    size_t written = 0;
+    while (written < record.size()) {
+        ssize_t n = write(fd, record.data() + written, record.size() - written);
+        if (n <= 0) break;
+        written += n;
+    }
+    flock(fd, LOCK_UN);
+}
+
+bool query_log::read(const std::string& path, std::vector<query_record>& records) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        llvm::errs() << "c2z3: cannot read query log " << path << "\n";
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty()) continue;
+        std::istringstream header(line);
+        std::string tag, assertion, timeout, solve_ms, config_size, smt2_size;
+        query_record r;
+        std::getline(header, tag, '\t');
+        std::getline(header, r.function, '\t');
+        std::getline(header, assertion, '\t');
+        std::getline(header, r.backend, '\t');
+        std::getline(header, timeout, '\t');
+        std::getline(header, r.result, '\t');
+        std::getline(header, solve_ms, '\t');
+        std::getline(header, config_size, '\t');
+        std::getline(header, smt2_size, '\t');
+        if (tag != "query" || !header) {
+            llvm::errs() << path << ": malformed record " << records.size() << "\n";
+            return false;
+        }
+        try {
+            r.assertion = std::stoi(assertion);
+            r.timeout_ms = std::stoul(timeout);
+            r.solve_ms = std::stod(solve_ms);
+            r.config.resize(std::stoul(config_size));
+            r.smt2.resize(std::stoul(smt2_size));
+        } catch (const std::exception&) {
+            llvm::errs() << path << ": malformed record " << records.size() << "\n";
+            return false;
+        }
+        in.read(&r.config[0], r.config.size());
+        in.read(&r.smt2[0], r.smt2.size());
+        if (!in) {
+            llvm::errs() << path << ": record " << records.size() << " is truncated\n";
+            return false;
+        }
+        records.push_back(std::move(r));
+    }
+    return true;
+}
@@ -1,31 +1,28 @@
 #include "rec_solver.h"
-#include <iostream>
+#include <algorithm>
 #include <numeric>
+#include <set>
+#include <vector>
 
-static void combine_vec(z3::expr_vector& vec1, const z3::expr_vector& vec2) {
-    for (z3::expr e : vec2) {
-        vec1.push_back(e);
-    }
-}
-
+// every application in rhs is arithmetic or of func_decl; walked with an explicit
+// stack, recurrences of long loop bodies are deep terms
 bool is_simple_rec(z3::func_decl func_decl, z3::expr rhs) {
-    if (rhs.is_numeral() || rhs.is_const()) return true;
-
-    auto args = rhs.args();
-    auto kind = rhs.decl().decl_kind();
-    bool is_all_simple_rec = true;
-    for (auto e : args) {
-        if (!is_simple_rec(func_decl, e)) {
-            is_all_simple_rec = false;
-            break;
+    std::vector<z3::expr> todo;
+    std::set<unsigned> seen;
+    todo.push_back(rhs);
+    while (!todo.empty()) {
+        z3::expr e = todo.back();
+        todo.pop_back();
+        if (e.is_numeral() || e.is_const()) continue;
+        // ids stay valid, the subterms are kept alive by rhs
+        if (!seen.insert(e.id()).second) continue;
+        auto kind = e.decl().decl_kind();
+        if (kind != Z3_OP_ADD && kind != Z3_OP_MUL && kind != Z3_OP_SUB && func_decl.id() != e.decl().id()) {
+            return false;
+        }
+        for (unsigned i = 0; i < e.num_args(); i++) {
+            todo.push_back(e.arg(i));
         }
-    }
-    if (kind == Z3_OP_ADD || kind == Z3_OP_MUL || kind == Z3_OP_SUB) {
-        return is_all_simple_rec;
-        // return std::all_of(args.begin(), args.end(), [func_decl](z3::expr e) { return is_simple_rec(func_decl, e); });
-    } else {
-        return func_decl.id() == rhs.decl().id() && is_all_simple_rec;
-        // return func_decl.id() == rhs.decl().id() && std::all_of(args.begin(), args.end(), [func_decl](z3::expr e) { return is_simple_rec(func_decl, e); });
     }
     return true;
 }
@@ -36,45 +33,71 @@ void rec_solver::set_ind_var(z3::expr var) {
 
 z3::expr_vector find_all_app_of_decl(z3::func_decl func, z3::expr e, z3::context& z3ctx) {
     z3::expr_vector res(z3ctx);
-    auto args = e.args();
-    auto kind = e.decl().decl_kind();
-    if (kind == Z3_OP_ADD || kind == Z3_OP_MUL || kind == Z3_OP_SUB) {
-        for (auto arg : args) {
-            combine_vec(res, find_all_app_of_decl(func, arg, z3ctx));
-        }
-    } else if (func.id() == e.decl().id()) {
-        res.push_back(e);
+    std::vector<z3::expr> todo;
+    todo.push_back(e);
+    while (!todo.empty()) {
+        z3::expr cur = todo.back();
+        todo.pop_back();
+        auto kind = cur.decl().decl_kind();
+        if (kind == Z3_OP_ADD || kind == Z3_OP_MUL || kind == Z3_OP_SUB) {
+            // reversed, the applications are found left to right
+            for (unsigned i = cur.num_args(); i > 0; i--) {
+                todo.push_back(cur.arg(i - 1));
+            }
+        } else if (func.id() == cur.decl().id()) {
+            res.push_back(cur);
+        }
     }
     return res;
 }
 
+// the coefficients of the summands are computed before their sum, each shared
+// subterm once
 z3::expr coeff_of(z3::expr e, z3::expr term, z3::context& z3ctx) {
-    auto kind = e.decl().decl_kind();
-    auto args = e.args();
-    z3::expr res = z3ctx.int_val(0);
-    if (kind == Z3_OP_ADD) {
-        for (auto arg : args) {
-            res = res + coeff_of(arg, term, z3ctx);
-        }
-    } else if (kind == Z3_OP_SUB) {
-        assert(args.size() == 2);
-        res = coeff_of(args[0], term, z3ctx) - coeff_of(args[1], term, z3ctx);
-    } else if (kind == Z3_OP_MUL) {
-        int i = 0;
-        for (i = 0; i < args.size(); i++) {
-            if ((args[i] == term).simplify().is_true()) break;
-        }
-        if (i != args.size()) {
-            res = z3ctx.int_val(1);
-            for (int j = 0; j < args.size(); j++) {
-                if (j == i) continue;
-                res = res * args[j];
+    std::map<unsigned, z3::expr> coeff;
+    // (term, whether its summands are done)
+    std::vector<std::pair<z3::expr, bool>> todo;
+    todo.emplace_back(e, false);
+    while (!todo.empty()) {
+        z3::expr cur = todo.back().first;
+        bool args_done = todo.back().second;
+        todo.pop_back();
+        if (coeff.count(cur.id())) continue;
+        auto kind = cur.decl().decl_kind();
+        auto args = cur.args();
+        if ((kind == Z3_OP_ADD || kind == Z3_OP_SUB) && !args_done) {
+            todo.emplace_back(cur, true);
+            for (auto arg : args) {
+                todo.emplace_back(arg, false);
             }
+            continue;
         }
-    } else if ((e == term).simplify().is_true()) {
-        res = z3ctx.int_val(1);
+        z3::expr res = z3ctx.int_val(0);
+        if (kind == Z3_OP_ADD) {
+            for (auto arg : args) {
+                res = res + coeff.at(arg.id());
+            }
+        } else if (kind == Z3_OP_SUB) {
+            assert(args.size() == 2);
+            res = coeff.at(args[0].id()) - coeff.at(args[1].id());
+        } else if (kind == Z3_OP_MUL) {
+            int i = 0;
+            for (i = 0; i < args.size(); i++) {
+                if ((args[i] == term).simplify().is_true()) break;
+            }
+            if (i != args.size()) {
+                res = z3ctx.int_val(1);
+                for (int j = 0; j < args.size(); j++) {
+                    if (j == i) continue;
+                    res = res * args[j];
+                }
+            }
+        } else if ((cur == term).simplify().is_true()) {
+            res = z3ctx.int_val(1);
+        }
+        coeff.emplace(cur.id(), res.simplify());
     }
-    return res.simplify();
+    return coeff.at(e.id());
 }
 
 bool is_one_stride_simple_rec(z3::expr lhs, z3::expr rhs) {
@@ -82,48 +105,312 @@ bool is_one_stride_simple_rec(z3::expr lhs, z3::expr rhs) {
     z3::expr lhs_arg = lhs.arg(0);
 }
 
-rec_solver::rec_solver(std::map<z3::expr, z3::expr>& eqs, z3::expr var, z3::context& z3ctx): z3ctx(z3ctx), ind_var(z3ctx) {
+rec_solver::rec_solver(expr_map& eqs, z3::expr var, z3::context& z3ctx): z3ctx(z3ctx), ind_var(z3ctx) {
     set_eqs(eqs);
     set_ind_var(var);
 }
 
-void rec_solver::set_eqs(std::map<z3::expr, z3::expr>& eqs) {
+void rec_solver::set_eqs(expr_map& eqs) {
     rec_eqs = eqs;
 }
 
-void rec_solver::simple_solve() {
-    for (auto& func_eq : rec_eqs) {
-        z3::expr func = func_eq.first;
-        z3::expr eq = func_eq.second;
-        if (is_simple_rec(func.decl(), eq)) {
-            z3::expr_vector all_app = find_all_app_of_decl(func.decl(), eq, z3ctx);
-            z3::expr linear_part = z3ctx.int_val(0);
-            for (auto app : all_app) {
-                linear_part = linear_part + coeff_of(eq, app, z3ctx)*app;
-                // std::cout << coeff_of(eq, app, z3ctx) << std::endl;
+// sums and products folding numerals as they are built; the polynomials are not
+// simplified, simplification would rewrite the exact divisions
+static z3::expr plus(z3::expr a, z3::expr b) {
+    if (a.is_numeral() && b.is_numeral()) return a.ctx().int_val(a.get_numeral_int64() + b.get_numeral_int64());
+    if (a.is_numeral() && a.get_numeral_int64() == 0) return b;
+    if (b.is_numeral() && b.get_numeral_int64() == 0) return a;
+    return a + b;
+}
+
+static z3::expr times(z3::expr a, z3::expr b) {
+    if (a.is_numeral() && b.is_numeral()) return a.ctx().int_val(a.get_numeral_int64() * b.get_numeral_int64());
+    if (a.is_numeral() && a.get_numeral_int64() == 1) return b;
+    if (b.is_numeral() && b.get_numeral_int64() == 1) return a;
+    if ((a.is_numeral() && a.get_numeral_int64() == 0) || (b.is_numeral() && b.get_numeral_int64() == 0)) return a.ctx().int_val(0);
+    return a * b;
+}
+
+// (coeffs[0] + coeffs[1]*var + coeffs[2]*var^2 + ...) / denominator
+struct polynomial {
+    std::vector<z3::expr> coeffs;
+    int64_t denominator = 1;
+    void scale(int64_t k) {
+        for (z3::expr& c : coeffs) {
+            c = times(c, c.ctx().int_val(k));
+        }
+        denominator *= k;
+    }
+};
+
+static bool is_value(z3::expr e, int64_t value) {
+    z3::expr simple = e.simplify();
+    return simple.is_numeral() && simple.get_numeral_int64() == value;
+}
+
+// e as a polynomial in var whose coefficients do not mention var; false if it
+// is not one. Integer divisions are only read as exact if their id is in exact.
+static bool polynomial_in(z3::expr e, z3::expr var, const std::set<unsigned>& exact, polynomial& res, z3::context& z3ctx) {
+    // the polynomial of every subterm, absent if it has none
+    std::map<unsigned, polynomial> poly;
+    std::set<unsigned> failed;
+    std::vector<std::pair<z3::expr, bool>> todo;
+    todo.emplace_back(e, false);
+    while (!todo.empty()) {
+        z3::expr cur = todo.back().first;
+        bool args_done = todo.back().second;
+        todo.pop_back();
+        if (poly.count(cur.id()) || failed.count(cur.id())) continue;
+        if (cur.id() == var.id()) {
+            poly.emplace(cur.id(), polynomial{{z3ctx.int_val(0), z3ctx.int_val(1)}});
+            continue;
+        }
+        if (!cur.is_app()) {
+            failed.insert(cur.id());
+            continue;
+        }
+        if (!args_done && cur.num_args() > 0) {
+            todo.emplace_back(cur, true);
+            for (unsigned i = 0; i < cur.num_args(); i++) {
+                todo.emplace_back(cur.arg(i), false);
+            }
+            continue;
+        }
+        std::vector<polynomial> args;
+        bool constant = true;
+        bool ok = true;
+        for (unsigned i = 0; i < cur.num_args(); i++) {
+            auto it = poly.find(cur.arg(i).id());
+            if (it == poly.end()) {
+                ok = false;
+                break;
             }
-            z3::expr const_term = (eq - linear_part).simplify();
-            if (all_app.size() == 1 && coeff_of(eq, all_app[0], z3ctx) == 1) {
-                auto func_decl = func.decl();
-                res.insert_or_assign(func_decl(ind_var), func_decl(0) + ind_var*const_term);
+            args.push_back(it->second);
+            constant = constant && it->second.coeffs.size() == 1;
+        }
+        auto kind = cur.decl().decl_kind();
+        polynomial p;
+        if (ok && constant) {
+            p.coeffs.push_back(cur);
+        } else if (ok && (kind == Z3_OP_ADD || kind == Z3_OP_SUB || kind == Z3_OP_UMINUS)) {
+            int64_t denominator = 1;
+            for (auto& arg : args) {
+                denominator = std::lcm(denominator, arg.denominator);
+            }
+            p.denominator = denominator;
+            for (unsigned i = 0; i < args.size(); i++) {
+                args[i].scale(denominator / args[i].denominator);
+                bool negated = kind == Z3_OP_UMINUS || (kind == Z3_OP_SUB && i > 0);
+                for (unsigned d = 0; d < args[i].coeffs.size(); d++) {
+                    z3::expr c = negated ? times(z3ctx.int_val(-1), args[i].coeffs[d]) : args[i].coeffs[d];
+                    if (d < p.coeffs.size()) {
+                        p.coeffs[d] = plus(p.coeffs[d], c);
+                    } else {
+                        p.coeffs.push_back(c);
+                    }
+                }
             }
+        } else if (ok && kind == Z3_OP_MUL) {
+            p.coeffs.push_back(z3ctx.int_val(1));
+            for (auto& factor : args) {
+                std::vector<z3::expr> product(p.coeffs.size() + factor.coeffs.size() - 1, z3ctx.int_val(0));
+                for (unsigned i = 0; i < p.coeffs.size(); i++) {
+                    for (unsigned j = 0; j < factor.coeffs.size(); j++) {
+                        product[i + j] = plus(product[i + j], times(p.coeffs[i], factor.coeffs[j]));
+                    }
+                }
+                p.coeffs = product;
+                p.denominator *= factor.denominator;
+            }
+        } else if (ok && kind == Z3_OP_IDIV && exact.count(cur.id()) && cur.arg(1).is_numeral()) {
+            p = args[0];
+            p.denominator *= cur.arg(1).get_numeral_int64();
+        } else {
+            failed.insert(cur.id());
+            continue;
+        }
+        // x*var - x*var is a polynomial of lower degree
+        while (p.coeffs.size() > 1 && is_value(p.coeffs.back(), 0)) {
+            p.coeffs.pop_back();
         }
+        poly.emplace(cur.id(), p);
     }
+    auto it = poly.find(e.id());
+    if (it == poly.end()) return false;
+    res = it->second;
+    return true;
 }
 
-void rec_solver::expr_solve(z3::expr e) {
-    std::cout << e.to_string() << std::endl;
-    z3::expr_vector all_apps(z3ctx);
-    for (auto& i : rec_eqs) {
-        z3::func_decl f = i.first.decl();
-        std::cout << f.arity() << std::endl;
-        if (e.contains(f(ind_var))) {
-            all_apps.push_back(f(ind_var));
-            std::cout << f(ind_var).to_string() << std::endl;
+// the functions of the system applied in e, by their position in the system
+static std::set<unsigned> dependencies(z3::expr e, const std::map<unsigned, unsigned>& position) {
+    std::set<unsigned> res;
+    std::set<unsigned> seen;
+    std::vector<z3::expr> todo;
+    todo.push_back(e);
+    while (!todo.empty()) {
+        z3::expr cur = todo.back();
+        todo.pop_back();
+        if (!cur.is_app() || !seen.insert(cur.id()).second) continue;
+        auto it = position.find(cur.decl().id());
+        if (it != position.end()) res.insert(it->second);
+        for (unsigned i = 0; i < cur.num_args(); i++) {
+            todo.push_back(cur.arg(i));
+        }
+    }
+    return res;
+}
+
+// Tarjan's strongly connected components of deps (i depends on deps[i]),
+// every component after the ones it depends on
+static std::vector<std::vector<unsigned>> components(const std::vector<std::set<unsigned>>& deps) {
+    std::vector<std::vector<unsigned>> res;
+    std::vector<int> index(deps.size(), -1);
+    std::vector<int> low(deps.size(), 0);
+    std::vector<bool> on_stack(deps.size(), false);
+    std::vector<unsigned> stack;
+    int next = 0;
+    // (node, its next successor)
+    std::vector<std::pair<unsigned, std::set<unsigned>::const_iterator>> frames;
+    auto visit = [&](unsigned v) {
+        index[v] = low[v] = next++;
+        stack.push_back(v);
+        on_stack[v] = true;
+        frames.emplace_back(v, deps[v].begin());
+    };
+    for (unsigned root = 0; root < deps.size(); root++) {
+        if (index[root] >= 0) continue;
+        visit(root);
+        while (!frames.empty()) {
+            unsigned v = frames.back().first;
+            if (frames.back().second != deps[v].end()) {
+                unsigned w = *frames.back().second++;
+                if (index[w] < 0) {
+                    visit(w);
+                } else if (on_stack[w]) {
+                    low[v] = std::min(low[v], index[w]);
+                }
+                continue;
+            }
+            frames.pop_back();
+            if (!frames.empty()) {
+                unsigned parent = frames.back().first;
+                low[parent] = std::min(low[parent], low[v]);
+            }
+            if (low[v] != index[v]) continue;
+            std::vector<unsigned> component;
+            unsigned w;
+            do {
+                w = stack.back();
+                stack.pop_back();
+                on_stack[w] = false;
+                component.push_back(w);
+            } while (w != v);
+            res.push_back(component);
+        }
+    }
+    return res;
+}
+
+// the sum of k^degree for k from 0 to n - 1 (Faulhaber) as numerator / denominator,
+// for degree <= 3
+static std::pair<z3::expr, int64_t> power_sum(unsigned degree, z3::expr n) {
+    switch (degree) {
+        case 0: return {n, 1};
+        case 1: return {n * (n - 1), 2};
+        case 2: return {n * (n - 1) * (2 * n - 1), 6};
+        default: return {n * n * (n - 1) * (n - 1), 4};
+    }
+}
+
+// The recurrences are solved one strongly connected component at a time, the
+// components a recurrence depends on first; their closed forms are substituted
+// into it, so a triangular system is solved in one pass. A recurrence
+// f(n + 1) = f(n) + p(n) or f(n + 1) = p(n), p a polynomial of degree <= 3 in the
+// induction variable, is solved; mutually recursive ones are not.
+void rec_solver::simple_solve() {
+    std::vector<z3::expr> lhs;
+    std::vector<z3::expr> rhs;
+    std::map<unsigned, unsigned> position;
+    for (auto& func_eq : rec_eqs) {
+        position.emplace(func_eq.first.decl().id(), lhs.size());
+        lhs.push_back(func_eq.first);
+        rhs.push_back(func_eq.second);
+    }
+    std::vector<std::set<unsigned>> deps;
+    for (z3::expr eq : rhs) {
+        deps.push_back(dependencies(eq, position));
+    }
+    // the closed forms found so far, substituted into the later recurrences
+    z3::expr_vector solved(z3ctx);
+    z3::expr_vector closed(z3ctx);
+    // the divisions of the closed forms, exact by construction
+    std::set<unsigned> exact;
+    z3::expr tmp = z3ctx.int_const("!rec");
+    z3::expr_vector tmp_vec(z3ctx);
+    tmp_vec.push_back(tmp);
+    z3::expr_vector ind_vec(z3ctx);
+    ind_vec.push_back(ind_var);
+    z3::expr_vector prev_vec(z3ctx);
+    prev_vec.push_back(ind_var - 1);
+    for (auto& component : components(deps)) {
+        if (component.size() != 1) continue;
+        unsigned i = component.front();
+        z3::func_decl func = lhs[i].decl();
+        if (!func.range().is_int() || lhs[i].num_args() == 0) continue;
+        // f(..., n + 1) = rhs, the closed form is of f(..., n) from f(..., 0)
+        z3::expr_vector cur_args(z3ctx);
+        z3::expr_vector init_args(z3ctx);
+        for (unsigned j = 0; j + 1 < lhs[i].num_args(); j++) {
+            cur_args.push_back(lhs[i].arg(j));
+            init_args.push_back(lhs[i].arg(j));
+        }
+        cur_args.push_back(ind_var);
+        init_args.push_back(z3ctx.int_val(0));
+        z3::expr cur = func(cur_args);
+        z3::expr init = func(init_args);
+        z3::expr eq = solved.empty() ? rhs[i] : rhs[i].substitute(solved, closed);
+        z3::expr_vector cur_vec(z3ctx);
+        cur_vec.push_back(cur);
+        // rhs = a*f(n) + p(n): linear in f(n) with a = 0 or 1, p a polynomial in n
+        polynomial in_cur;
+        polynomial in_n;
+        if (!polynomial_in(eq.substitute(cur_vec, tmp_vec), tmp, exact, in_cur, z3ctx) || in_cur.coeffs.size() > 2) continue;
+        if (!polynomial_in(in_cur.coeffs[0], ind_var, exact, in_n, z3ctx) || in_n.coeffs.size() > 4) continue;
+        in_n.denominator *= in_cur.denominator;
+        z3::expr p = in_cur.coeffs[0];
+        if (in_cur.denominator != 1) {
+            p = p / z3ctx.int_val(in_cur.denominator);
+            exact.insert(p.id());
+        }
+        if (in_cur.coeffs.size() == 1) {
+            closed.push_back(z3::ite(ind_var == 0, init, p.substitute(ind_vec, prev_vec)));
+        } else if (is_value(in_cur.coeffs[1], in_cur.denominator)) {
+            // f(n) = f(0) + the sum of p(k) for k < n, over a common denominator;
+            // the sum of the integers p(k) is one, the division is exact
+            int64_t denominator = in_n.denominator;
+            for (unsigned d = 0; d < in_n.coeffs.size(); d++) {
+                denominator = std::lcm(denominator, in_n.denominator * power_sum(d, ind_var).second);
+            }
+            z3::expr sum(z3ctx);
+            for (unsigned d = 0; d < in_n.coeffs.size(); d++) {
+                auto power = power_sum(d, ind_var);
+                int64_t scale = denominator / (in_n.denominator * power.second);
+                z3::expr term = times(times(in_n.coeffs[d], z3ctx.int_val(scale)), power.first);
+                sum = d == 0 ? term : plus(sum, term);
+            }
+            if (denominator != 1) {
+                sum = sum / z3ctx.int_val(denominator);
+                exact.insert(sum.id());
+            }
+            closed.push_back(plus(init, sum));
+        } else {
+            continue;
         }
+        solved.push_back(cur);
+        res.insert_or_assign(cur, closed.back());
     }
 }
 
-std::map<z3::expr, z3::expr> rec_solver::get_res() const {
+expr_map rec_solver::get_res() const {
     return res;
 }
\ No newline at end of file
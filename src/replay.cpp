@@ -0,0 +1,143 @@
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "z3++.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "query_log.h"
+#include "solver_backend.h"
+#include "solver_config.h"
+
+using namespace llvm;
+
+static cl::OptionCategory ReplayCategory("c2z3-replay options");
+static cl::opt<std::string> LogFile(cl::Positional, cl::desc("<query log written by c2z3 -record>"), cl::Required, cl::cat(ReplayCategory));
+static cl::list<unsigned> Records("records", cl::desc("Replay only these records (0-based, default: all)"), cl::CommaSeparated, cl::cat(ReplayCategory));
+static cl::opt<std::string> Function("function", cl::desc("Replay only the queries of this function"), cl::init(""), cl::cat(ReplayCategory));
+static cl::opt<unsigned> Repeat("repeat", cl::desc("Solve every query this many times, the median time is reported"), cl::init(1), cl::cat(ReplayCategory));
+static cl::opt<unsigned> Timeout("timeout", cl::desc("Milliseconds per query (0: as recorded)"), cl::init(0), cl::cat(ReplayCategory));
+static cl::list<std::string> Solvers("solver", cl::desc("Solve with these backends instead of the recorded ones, as in c2z3 -solver"), cl::cat(ReplayCategory));
+static cl::opt<std::string> Config("z3-config", cl::desc("Solve with these Z3 options instead of the recorded ones"), cl::init(""), cl::cat(ReplayCategory));
+static cl::opt<std::string> CSV("csv", cl::desc("Write one line per replayed record to this CSV file"), cl::init(""), cl::cat(ReplayCategory));
+
+namespace {
+
+std::unique_ptr<solver_backend> backends_of(const std::vector<std::string>& specs) {
+    if (specs.size() == 1) return make_backend(specs.front());
+    std::vector<std::unique_ptr<solver_backend>> backends;
+    for (const std::string& spec : specs) {
+        backends.push_back(make_backend(spec));
+    }
+    return std::make_unique<racing_backend>(std::move(backends));
+}
+
+// the backends of the recorded run, racing_backend names them joined by " | "
+std::vector<std::string> recorded_backends(const std::string& name) {
+    std::vector<std::string> res;
+    size_t begin = 0;
+    while (true) {
+        size_t end = name.find(" | ", begin);
+        res.push_back(name.substr(begin, end - begin));
+        if (end == std::string::npos) return res;
+        begin = end + 3;
+    }
+}
+
+// the answer and the time it took; parameters are global, each run gets a fresh context
+z3::check_result solve(const query_record& r, const solver_config& cfg, solver_backend& backend, unsigned timeout, double& ms) {
+    z3::reset_params();
+    cfg.install();
+    z3::context z3ctx;
+    z3::solver solver = cfg.make_solver(z3ctx);
+    solver.add(z3ctx.parse_string(r.smt2.data()));
+    auto start = std::chrono::steady_clock::now();
+    z3::check_result result = backend.check(solver, r.smt2, timeout);
+    ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+const char* result_name(z3::check_result r) {
+    return r == z3::sat ? "sat" : r == z3::unsat ? "unsat" : "unknown";
+}
+
+}
+
+int main(int argc, char** argv) {
+    cl::HideUnrelatedOptions(ReplayCategory);
+    cl::ParseCommandLineOptions(argc, argv, "c2z3-replay: re-run the solver queries recorded by c2z3 -record\n");
+    std::vector<query_record> records;
+    if (!query_log::read(LogFile, records)) return 1;
+    solver_config override_cfg;
+    if (!Config.empty() && !override_cfg.load(Config)) return 1;
+    std::ofstream csv;
+    if (!CSV.empty()) {
+        csv.open(CSV);
+        csv << "record,function,assertion,recorded,recorded_ms,replayed,replayed_ms\n";
+    }
+
+    std::vector<unsigned> selected(Records.begin(), Records.end());
+    if (selected.empty()) {
+        for (unsigned i = 0; i < records.size(); i++) {
+            selected.push_back(i);
+        }
+    }
+    std::vector<std::string> solvers(Solvers.begin(), Solvers.end());
+    unsigned replayed = 0;
+    unsigned mismatches = 0;
+    double recorded_total = 0;
+    double replayed_total = 0;
+    for (unsigned i : selected) {
+        if (i >= records.size()) {
+            errs() << "c2z3-replay: " << LogFile << " has only " << records.size() << " records\n";
+            return 1;
+        }
+        const query_record& r = records[i];
+        if (!Function.empty() && r.function != Function) continue;
+        solver_config cfg = override_cfg;
+        if (Config.empty()) {
+            std::istringstream in(r.config);
+            if (!cfg.read(in, LogFile + " record " + std::to_string(i))) return 1;
+        }
+        std::unique_ptr<solver_backend> backend = backends_of(solvers.empty() ? recorded_backends(r.backend) : solvers);
+        unsigned timeout = Timeout ? (unsigned)Timeout : r.timeout_ms;
+
+        std::vector<double> times;
+        z3::check_result result = z3::unknown;
+        for (unsigned run = 0; run < std::max(1u, (unsigned)Repeat); run++) {
+            double ms = 0;
+            try {
+                result = solve(r, cfg, *backend, timeout, ms);
+            } catch (const z3::exception& e) {
+                errs() << "c2z3-replay: record " << i << ": " << e.msg() << "\n";
+                result = z3::unknown;
+                ms = timeout;
+            }
+            times.push_back(ms);
+        }
+        std::sort(times.begin(), times.end());
+        double ms = times[times.size() / 2];
+        // a definite answer contradicting the recorded one is a soundness problem, not a slowdown
+        bool mismatch = result != z3::unknown && r.result != "unknown" && r.result != result_name(result);
+        mismatches += mismatch;
+        replayed++;
+        recorded_total += r.solve_ms;
+        replayed_total += ms;
+        errs() << "[" << i << "] " << r.function << "#" << r.assertion << ": recorded " << r.result << " in " << (unsigned)r.solve_ms
+               << " ms, replayed " << result_name(result) << " in " << (unsigned)ms << " ms" << (mismatch ? " MISMATCH" : "") << "\n";
+        if (csv.is_open()) {
+            csv << i << "," << r.function << "," << r.assertion << "," << r.result << "," << r.solve_ms << "," << result_name(result) << "," << ms << "\n";
+        }
+    }
+    z3::reset_params();
+    errs() << "replayed " << replayed << " queries: " << (unsigned)recorded_total << " ms recorded, " << (unsigned)replayed_total << " ms now";
+    if (mismatches) errs() << ", " << mismatches << " answers differ";
+    errs() << "\n";
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,69 @@
+#include "result_stream.h"
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+
+static std::string json_string(const std::string& s) {
+    std::string res = "\"";
+    for (char c : s) {
+        switch (c) {
+            case '"': res += "\\\""; break;
+            case '\\': res += "\\\\"; break;
+            case '\n': res += "\\n"; break;
+            case '\t': res += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    res += buf;
+                } else {
+                    res += c;
+                }
+        }
+    }
+    return res + "\"";
+}
+
+std::string assertion_result::serialize() const {
+    std::ostringstream os;
+    os << verdict << " " << encode_ms << " " << solve_ms << " " << query_size << " " << cache_hit << " " << decided_by << " " << witness;
+    return os.str();
+}
+
+assertion_result assertion_result::parse(const std::string& line) {
+    assertion_result r;
+    std::istringstream is(line);
+    is >> r.verdict >> r.encode_ms >> r.solve_ms >> r.query_size >> r.cache_hit >> r.decided_by;
+    // the witness is last and may hold spaces (input names are free-form)
+    std::getline(is >> std::ws, r.witness);
+    return r;
+}
+
+result_stream::result_stream(const std::string& path): out(nullptr) {
+    if (path == "-") {
+        out = &std::cout;
+    } else if (!path.empty()) {
+        file.open(path, std::ios::app);
+        out = &file;
+    }
+}
+
+bool result_stream::enabled() const {
+    return out != nullptr;
+}
+
+void result_stream::write(const std::string& function, int index, const std::string& location, const assertion_result& r) {
+    if (!out) return;
+    *out << "{\"function\":" << json_string(function)
+         << ",\"assertion\":" << index
+         << ",\"location\":" << (location.empty() ? "null" : json_string(location))
+         << ",\"verdict\":" << json_string(r.verdict)
+         << ",\"encode_ms\":" << r.encode_ms
+         << ",\"solve_ms\":" << r.solve_ms
+         << ",\"query_size\":" << r.query_size
+         << ",\"cache_hit\":" << (r.cache_hit ? "true" : "false")
+         << ",\"decided_by\":" << json_string(r.decided_by)
+         << ",\"witness\":" << (r.witness.empty() ? "null" : json_string(r.witness))
+         << "}\n";
+    out->flush();
+}
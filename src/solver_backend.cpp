@@ -0,0 +1,214 @@
+#include "solver_backend.h"
+#include <sys/wait.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+
+z3_backend::z3_backend(): running(nullptr), cancelled(false) {}
+
+std::string z3_backend::name() const {
+    return "z3";
+}
+
+z3::check_result z3_backend::check(z3::solver& query, const std::string&, unsigned timeout) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        cancelled = false;
+    }
+    z3::params p(query.ctx());
+    p.set(":timeout", timeout);
+    query.set(p);
+    {
+        // a cancel() that came before running was set interrupted nothing
+        std::lock_guard<std::mutex> guard(lock);
+        if (cancelled) return z3::unknown;
+        running = &query.ctx();
+    }
+    z3::check_result result = query.check();
+    std::lock_guard<std::mutex> guard(lock);
+    running = nullptr;
+    if (cancelled) return z3::unknown;
+    return result;
+}
+
+void z3_backend::cancel() {
+    // an interrupt outside of check() is dropped by Z3
+    std::lock_guard<std::mutex> guard(lock);
+    cancelled = true;
+    if (running) running->interrupt();
+}
+
+smtlib_backend::smtlib_backend(const std::string& command): command(command), pid(-1), cancelled(false) {}
+
+std::string smtlib_backend::name() const {
+    return command;
+}
+
+static z3::check_result parse_answer(const std::string& output) {
+    size_t begin = output.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) return z3::unknown;
+    std::string answer = output.substr(begin, output.find_first_of(" \t\r\n", begin) - begin);
+    if (answer == "sat") return z3::sat;
+    if (answer == "unsat") return z3::unsat;
+    return z3::unknown;
+}
+
+z3::check_result smtlib_backend::check(z3::solver&, const std::string& smt2, unsigned timeout) {
+    signal(SIGPIPE, SIG_IGN);
+    int in_pipe[2];
+    int out_pipe[2];
+    if (pipe(in_pipe) != 0) return z3::unknown;
+    if (pipe(out_pipe) != 0) {
+        close(in_pipe[0]);
+        close(in_pipe[1]);
+        return z3::unknown;
+    }
+    // exec, so that killing the shell kills the solver; built before the fork,
+    // the child of a threaded process may not allocate
+    std::string exec_command = "exec " + command;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        cancelled = false;
+        fflush(nullptr);
+        pid = fork();
+        if (pid == 0) {
+            dup2(in_pipe[0], STDIN_FILENO);
+            dup2(out_pipe[1], STDOUT_FILENO);
+            close(in_pipe[0]);
+            close(in_pipe[1]);
+            close(out_pipe[0]);
+            close(out_pipe[1]);
+            execl("/bin/sh", "sh", "-c", exec_command.c_str(), (char*)nullptr);
+            _exit(127);
+        }
+    }
+    close(in_pipe[0]);
+    close(out_pipe[1]);
+    if (pid < 0) {
+        close(in_pipe[1]);
+        close(out_pipe[0]);
+        return z3::unknown;
+    }
+
+    // the query is written while the answer is read, a solver may start
+    // answering before it has consumed all of its input
+    std::string input = smt2 + "\n(exit)\n";
+    size_t written = 0;
+    int in_fd = in_pipe[1];
+    std::string output;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+    bool answered = false;
+    while (!answered) {
+        int left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0) break;
+        std::vector<pollfd> fds{pollfd{out_pipe[0], POLLIN, 0}};
+        if (in_fd >= 0) fds.push_back(pollfd{in_fd, POLLOUT, 0});
+        if (poll(fds.data(), fds.size(), left) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds.size() > 1 && fds[1].revents) {
+            ssize_t n = write(in_fd, input.data() + written, std::min<size_t>(input.size() - written, 65536));
+            if (n > 0) written += n;
+            if (n < 0 || written == input.size()) {
+                close(in_fd);
+                in_fd = -1;
+            }
+        }
+        if (fds[0].revents) {
+            char chunk[4096];
+            ssize_t n = read(out_pipe[0], chunk, sizeof(chunk));
+            if (n <= 0) {
+                // exited, possibly without ending its answer with a newline
+                answered = !output.empty();
+                break;
+            }
+            output.append(chunk, n);
+            answered = output.find('\n') != std::string::npos;
+        }
+    }
+    if (in_fd >= 0) close(in_fd);
+    close(out_pipe[0]);
+
+    std::lock_guard<std::mutex> guard(lock);
+    // a solver still running has timed out or lost a race
+    kill(pid, SIGKILL);
+    int status;
+    waitpid(pid, &status, 0);
+    pid = -1;
+    if (cancelled || !answered) return z3::unknown;
+    return parse_answer(output);
+}
+
+void smtlib_backend::cancel() {
+    std::lock_guard<std::mutex> guard(lock);
+    cancelled = true;
+    if (pid > 0) kill(pid, SIGKILL);
+}
+
+racing_backend::racing_backend(std::vector<std::unique_ptr<solver_backend>> backends): backends(std::move(backends)) {}
+
+std::string racing_backend::name() const {
+    std::string res;
+    for (auto& b : backends) {
+        res += (res.empty() ? "" : " | ") + b->name();
+    }
+    return res;
+}
+
+z3::check_result racing_backend::check(z3::solver& query, const std::string& smt2, unsigned timeout) {
+    std::mutex lock;
+    std::condition_variable done;
+    z3::check_result result = z3::unknown;
+    unsigned finished = 0;
+    auto race = [&](unsigned i) {
+        z3::check_result r = z3::unknown;
+        bool decided;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            decided = result != z3::unknown;
+        }
+        if (!decided) r = backends[i]->check(query, smt2, timeout);
+        std::lock_guard<std::mutex> guard(lock);
+        if (result == z3::unknown && r != z3::unknown) result = r;
+        finished++;
+        done.notify_one();
+    };
+    std::vector<std::thread> pool;
+    for (unsigned i = 0; i < backends.size(); i++) {
+        pool.emplace_back(race, i);
+    }
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        done.wait(guard, [&]() { return result != z3::unknown || finished == backends.size(); });
+        // the losers give up, their answers are not waited for. Z3 drops an
+        // interrupt that lands while its check is still starting up, and then
+        // outlives its timeout as well, so they are cancelled until they return
+        while (finished < backends.size()) {
+            guard.unlock();
+            cancel();
+            guard.lock();
+            done.wait_for(guard, std::chrono::milliseconds(10), [&]() { return finished == backends.size(); });
+        }
+    }
+    for (std::thread& t : pool) {
+        t.join();
+    }
+    return result;
+}
+
+void racing_backend::cancel() {
+    for (auto& b : backends) {
+        b->cancel();
+    }
+}
+
+std::unique_ptr<solver_backend> make_backend(const std::string& spec) {
+    if (spec == "z3") return std::make_unique<z3_backend>();
+    return std::make_unique<smtlib_backend>(spec);
+}
@@ -0,0 +1,92 @@
+#include "solver_config.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <fstream>
+#include <sstream>
+
+static std::string trim(const std::string& s) {
+    size_t begin = s.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) return "";
+    return s.substr(begin, s.find_last_not_of(" \t\r") - begin + 1);
+}
+
+bool solver_config::load(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        llvm::errs() << "c2z3: cannot read solver configuration " << path << "\n";
+        return false;
+    }
+    return read(in, path);
+}
+
+bool solver_config::read(std::istream& in, const std::string& source) {
+    std::string line;
+    for (unsigned n = 1; std::getline(in, line); n++) {
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+        size_t eq = line.find('=');
+        std::string name = eq == std::string::npos ? "" : trim(line.substr(0, eq));
+        if (name.empty()) {
+            llvm::errs() << source << ":" << n << ": expected name=value\n";
+            return false;
+        }
+        set(name, trim(line.substr(eq + 1)));
+    }
+    return true;
+}
+
+bool solver_config::save(const std::string& path) const {
+    std::ofstream out(path);
+    out << to_string();
+    return bool(out);
+}
+
+void solver_config::set(const std::string& name, const std::string& value) {
+    for (auto& entry : entries) {
+        if (entry.first == name) {
+            entry.second = value;
+            return;
+        }
+    }
+    entries.emplace_back(name, value);
+}
+
+std::string solver_config::get(const std::string& name) const {
+    for (auto& entry : entries) {
+        if (entry.first == name) return entry.second;
+    }
+    return "";
+}
+
+const std::vector<std::pair<std::string, std::string>>& solver_config::params() const {
+    return entries;
+}
+
+void solver_config::install() const {
+    for (auto& entry : entries) {
+        if (entry.first == preprocess_key) continue;
+        z3::set_param(entry.first.data(), entry.second.data());
+    }
+}
+
+z3::solver solver_config::make_solver(z3::context& z3ctx) const {
+    std::string preprocess = get(preprocess_key);
+    if (preprocess.empty()) return z3::solver(z3ctx);
+    // tactics run one after the other, the last one being the SMT core
+    z3::tactic chain(z3ctx, "skip");
+    std::istringstream names(preprocess);
+    std::string name;
+    while (std::getline(names, name, ',')) {
+        name = trim(name);
+        if (!name.empty()) chain = chain & z3::tactic(z3ctx, name.data());
+    }
+    return (chain & z3::tactic(z3ctx, "smt")).mk_solver();
+}
+
+std::string solver_config::to_string() const {
+    std::ostringstream os;
+    for (auto& entry : entries) {
+        os << entry.first << "=" << entry.second << "\n";
+    }
+    return os.str();
+}
@@ -0,0 +1,236 @@
+#include "llvm/Analysis/CGSCCPassManager.h"
+#include "llvm/Analysis/LazyCallGraph.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/Analysis/PostDominators.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <thread>
+
+#include "summaries.h"
+#include "encoder.h"
+
+using namespace llvm;
+
+namespace {
+
+// records the SCCs of the call graph in post order, i.e. callees first
+struct scc_order : PassInfoMixin<scc_order> {
+    std::vector<std::vector<Function*>>* sccs;
+    PreservedAnalyses run(LazyCallGraph::SCC& C, CGSCCAnalysisManager&, LazyCallGraph&, CGSCCUpdateResult&) {
+        std::vector<Function*> functions;
+        for (LazyCallGraph::Node& N : C) {
+            functions.push_back(&N.getFunction());
+        }
+        sccs->push_back(functions);
+        return PreservedAnalyses::all();
+    }
+};
+
+}
+
+// the callee's symbols are renamed apart per call site, its parameters and result
+// are replaced by the actual arguments and the call's value
+static z3::expr rename(const z3::expr& e, const std::string& suffix, const std::map<std::string, z3::expr>& binding, std::map<unsigned, z3::expr>& done, z3::context& z3ctx) {
+    auto hit = done.find(e.id());
+    if (hit != done.end()) return hit->second;
+    z3::expr res = e;
+    if (e.is_quantifier()) {
+        z3::expr_vector terms(z3ctx);
+        std::vector<Z3_pattern> patterns;
+        std::vector<z3::ast> held;
+        for (unsigned i = 0; i < Z3_get_quantifier_num_patterns(z3ctx, e); i++) {
+            Z3_pattern p = Z3_get_quantifier_pattern_ast(z3ctx, e, i);
+            std::vector<Z3_ast> renamed;
+            for (unsigned j = 0; j < Z3_get_pattern_num_terms(z3ctx, p); j++) {
+                terms.push_back(rename(z3::expr(z3ctx, Z3_get_pattern(z3ctx, p, j)), suffix, binding, done, z3ctx));
+                renamed.push_back(terms.back());
+            }
+            patterns.push_back(Z3_mk_pattern(z3ctx, renamed.size(), renamed.data()));
+            // a fresh pattern is only kept alive until the next API call
+            held.push_back(z3::ast(z3ctx, Z3_pattern_to_ast(z3ctx, patterns.back())));
+        }
+        std::vector<Z3_symbol> names;
+        std::vector<Z3_sort> sorts;
+        for (unsigned i = 0; i < Z3_get_quantifier_num_bound(z3ctx, e); i++) {
+            names.push_back(Z3_get_quantifier_bound_name(z3ctx, e, i));
+            sorts.push_back(Z3_get_quantifier_bound_sort(z3ctx, e, i));
+        }
+        z3::expr body = rename(e.body(), suffix, binding, done, z3ctx);
+        Z3_ast q = Z3_mk_quantifier(z3ctx, e.is_forall(), Z3_get_quantifier_weight(z3ctx, e), patterns.size(), patterns.data(), names.size(), sorts.data(), names.data(), body);
+        z3ctx.check_error();
+        res = z3::expr(z3ctx, q);
+    } else if (e.is_app()) {
+        z3::expr_vector args(z3ctx);
+        std::vector<Z3_ast> raw_args;
+        for (unsigned i = 0; i < e.num_args(); i++) {
+            args.push_back(rename(e.arg(i), suffix, binding, done, z3ctx));
+            raw_args.push_back(args.back());
+        }
+        z3::func_decl f = e.decl();
+        if (f.decl_kind() == Z3_OP_UNINTERPRETED) {
+            auto bound = binding.find(f.name().str());
+            if (f.arity() == 0 && bound != binding.end()) {
+                res = bound->second;
+            } else {
+                z3::sort_vector domain(z3ctx);
+                for (unsigned i = 0; i < f.arity(); i++) {
+                    domain.push_back(f.domain(i));
+                }
+                std::string name = f.name().str() + suffix;
+                res = z3ctx.function(name.data(), domain, f.range())(args);
+            }
+        } else if (e.num_args() > 0) {
+            res = z3::expr(z3ctx, Z3_update_term(z3ctx, e, raw_args.size(), raw_args.data()));
+        }
+    }
+    done.emplace(e.id(), res);
+    return res;
+}
+
+void summary_store::summarize(Function& F) {
+    const ReturnInst* ret = nullptr;
+    for (const BasicBlock& bb : F) {
+        if (auto r = dyn_cast<ReturnInst>(bb.getTerminator())) {
+            if (ret) return;
+            ret = r;
+        }
+    }
+    if (!ret || !ret->getReturnValue() || !ret->getReturnValue()->getType()->isIntegerTy()) return;
+
+    DominatorTree DT(F);
+    PostDominatorTree PDT(F);
+    LoopInfo LI(DT);
+    // outside loop headers a phi left as a phi is encoded as equal to every
+    // incoming value at once, which no run satisfies
+    for (const BasicBlock& bb : F) {
+        if (LI.isLoopHeader(&bb)) continue;
+        for (const PHINode& phi : bb.phis()) {
+            if (phi_as_select(&phi, DT, PDT) == &phi && !phi.hasConstantValue()) return;
+        }
+    }
+    z3::context local;
+    std::string result_name = F.getName().str() + ".result";
+    z3::expr_vector facts(local);
+    translation_scope translator(&F, local);
+    try {
+        SetVector<const Value*> visited;
+        std::set<const Loop*> loops;
+        facts = rel2z3(ret->getReturnValue(), visited, LI, DT, PDT, loops, local);
+        z3::expr result = use2z3(ret->getOperandUse(0), LI, local);
+        facts.push_back(local.constant(result_name.data(), result.get_sort()) == result);
+    } catch (const encoding_error&) {
+        return;
+    }
+    std::vector<std::string> params;
+    for (const Argument& arg : F.args()) {
+        params.push_back(arg.getName().str());
+    }
+    // z3ctx is shared by all threads
+    std::lock_guard<std::mutex> guard(lock);
+    summary s{params, result_name, z3::expr_vector(z3ctx)};
+    for (z3::expr fact : facts) {
+        s.facts.push_back(z3::expr(z3ctx, Z3_translate(local, fact, z3ctx)));
+    }
+    summaries.emplace(&F, s);
+}
+
+void summary_store::compute(Module& mod, ModuleAnalysisManager& MAM, const std::set<Function*>& functions, unsigned threads) {
+    // summarizing must not create IR, other threads are reading it
+    for (Function* F : functions) {
+        DominatorTree DT(*F);
+        PostDominatorTree PDT(*F);
+        lower_phis(*F, DT, PDT);
+    }
+
+    std::vector<std::vector<Function*>> sccs;
+    ModulePassManager MPM;
+    MPM.addPass(createModuleToPostOrderCGSCCPassAdaptor(scc_order{{}, &sccs}));
+    MPM.run(mod, MAM);
+
+    // an SCC's level is one above its highest callee, SCCs of one level are independent
+    std::map<const Function*, unsigned> level;
+    std::vector<std::vector<std::vector<Function*>>> levels;
+    for (const std::vector<Function*>& scc : sccs) {
+        std::vector<Function*> members;
+        std::copy_if(scc.begin(), scc.end(), std::back_inserter(members), [&](Function* F) {
+            return functions.count(F);
+        });
+        if (members.empty()) continue;
+        unsigned l = 0;
+        for (Function* F : members) {
+            for (const Instruction& inst : instructions(*F)) {
+                auto call = dyn_cast<CallBase>(&inst);
+                const Function* callee = call ? call->getCalledFunction() : nullptr;
+                auto callee_level = level.find(callee);
+                if (callee_level != level.end()) l = std::max(l, callee_level->second + 1);
+            }
+        }
+        for (Function* F : members) {
+            level[F] = l;
+        }
+        if (levels.size() <= l) levels.resize(l + 1);
+        levels[l].push_back(members);
+    }
+
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    for (const auto& independent : levels) {
+        std::atomic<size_t> next(0);
+        auto work = [&]() {
+            for (size_t i = next++; i < independent.size(); i = next++) {
+                // in a recursive SCC only the members summarized before constrain a call
+                for (Function* F : independent[i]) {
+                    summarize(*F);
+                }
+            }
+        };
+        std::vector<std::thread> pool;
+        for (unsigned t = 0; t < std::min<size_t>(threads, independent.size()); t++) {
+            pool.emplace_back(work);
+        }
+        for (std::thread& t : pool) {
+            t.join();
+        }
+    }
+}
+
+z3::expr_vector summary_store::instantiate(const CallInst* call, const LoopInfo& LI, z3::context& target) const {
+    z3::expr_vector res(target);
+    std::lock_guard<std::mutex> guard(lock);
+    auto s = summaries.find(call->getCalledFunction());
+    if (s == summaries.end()) return res;
+    std::map<std::string, z3::expr> binding;
+    for (unsigned i = 0; i < s->second.params.size() && i < call->arg_size(); i++) {
+        if (s->second.params[i].empty()) continue;
+        binding.emplace(s->second.params[i], use2z3(call->getArgOperandUse(i), LI, target));
+    }
+    binding.emplace(s->second.result, def2z3(call, LI, target));
+    std::string suffix = "@" + call->getName().str();
+    // done is keyed by AST id, the translated facts must outlive it
+    z3::expr_vector translated(target);
+    std::map<unsigned, z3::expr> done;
+    for (z3::expr fact : s->second.facts) {
+        translated.push_back(z3::expr(target, Z3_translate(z3ctx, fact, target)));
+        res.push_back(rename(translated.back(), suffix, binding, done, target));
+    }
+    return res;
+}
+
+void summary_store::adopt(const summary_store& previous, const Function& old, const Function& F) {
+    std::lock_guard<std::mutex> guard_previous(previous.lock);
+    auto s = previous.summaries.find(&old);
+    if (s == previous.summaries.end()) return;
+    summary copy{s->second.params, s->second.result, z3::expr_vector(z3ctx)};
+    for (z3::expr fact : s->second.facts) {
+        copy.facts.push_back(z3::expr(z3ctx, Z3_translate(previous.z3ctx, fact, z3ctx)));
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    summaries.emplace(&F, copy);
+}
+
+unsigned summary_store::size() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return summaries.size();
+}
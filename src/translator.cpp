@@ -0,0 +1,249 @@
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/GetElementPtrTypeIterator.h"
+#include "llvm/IR/Module.h"
+
+#include "z3++.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "encoder.h"
+#include "translator.h"
+
+using namespace llvm;
+
+// the translators in scope on this thread, innermost last
+static thread_local std::vector<value_translator*> scopes;
+
+value_translator::value_translator(const Function* F, z3::context& z3ctx): F(F), z3ctx(z3ctx) {
+    scopes.push_back(this);
+}
+
+value_translator::~value_translator() {
+    scopes.erase(std::find(scopes.begin(), scopes.end(), this));
+}
+
+value_translator* value_translator::active(const Function* F, z3::context& z3ctx) {
+    for (auto it = scopes.rbegin(); it != scopes.rend(); it++) {
+        if ((*it)->F == F && &(*it)->z3ctx == &z3ctx) return *it;
+    }
+    return nullptr;
+}
+
+translation_scope::translation_scope(const Function* F, z3::context& z3ctx): translator(value_translator::active(F, z3ctx)) {
+    if (!translator) translator = &own.emplace(F, z3ctx);
+}
+
+const Function* function_of(const Value* v) {
+    // the selects phis are lowered to are in no block
+    if (auto inst = dyn_cast<Instruction>(v)) return inst->getParent() ? inst->getFunction() : nullptr;
+    if (auto arg = dyn_cast<Argument>(v)) return arg->getParent();
+    return nullptr;
+}
+
+// the loop indices a value defined at depth defDepth is applied to when it is used at depth userDepth
+z3::expr_vector index_args(int defDepth, int userDepth, bool from_latch, bool exit_cond, z3::context& z3ctx) {
+    z3::expr_vector args(z3ctx);
+    for (int i = 0; i < defDepth - 1; i++) {
+        std::string idx = std::string("n") + std::to_string(i);
+        args.push_back(z3ctx.int_const(idx.data()));
+    }
+    if (defDepth > 0) {
+        std::string idx = std::string("n") + std::to_string(defDepth - 1);
+        if (userDepth < defDepth || exit_cond) {
+            idx = std::string("N") + std::to_string(defDepth - 1);
+            args.push_back(z3ctx.int_const(idx.data()));
+        } else {
+            if (from_latch) {
+                args.push_back(z3ctx.int_const(idx.data()));
+            } else {
+                args.push_back(z3ctx.int_const(idx.data()) + 1);
+            }
+        }
+    }
+    return args;
+}
+
+z3::expr value_translator::term(const Value* v, value_role role, int defDepth, int depth) {
+    key k{v, role, depth};
+    auto found = memo.find(k);
+    if (found != memo.end()) return found->second;
+    bool isBoolTy = v->getType()->isIntegerTy(1);
+    z3::sort ret_sort = isBoolTy ? z3ctx.bool_sort() : z3ctx.int_sort();
+    z3::expr_vector args(z3ctx);
+    z3::expr res(z3ctx);
+    bool is_use = role == value_role::use || role == value_role::from_latch || role == value_role::exit;
+    if (auto CI = dyn_cast<ConstantInt>(v)) {
+        res = isBoolTy ? z3ctx.bool_val(*CI->getValue().getRawData() != 0) : z3ctx.int_val(CI->getSExtValue());
+    } else if (is_use && v->getType()->isPointerTy() && getUnderlyingObject(v) == v && !isa<PHINode>(v) && !isa<SelectInst>(v)) {
+        // pointers are byte offsets into their object
+        res = z3ctx.int_val(0);
+    } else if ((role == value_role::in_loop || role == value_role::initial) && isa<Argument>(v)) {
+        res = z3ctx.constant(v->getName().data(), ret_sort);
+    } else if (role == value_role::initial) {
+        res = z3ctx.int_const(v->getName().data());
+    } else {
+        if (is_use) {
+            args = index_args(defDepth, depth, role == value_role::from_latch, role == value_role::exit, z3ctx);
+        } else if (role == value_role::in_loop) {
+            for (int i = 0; i < depth; i++) {
+                args.push_back(z3ctx.int_const(("n" + std::to_string(i)).data()));
+            }
+        } else {
+            for (int i = 0; i < defDepth - 1; i++) {
+                args.push_back(z3ctx.int_const(("n" + std::to_string(i)).data()));
+            }
+            if (defDepth > 0) {
+                z3::expr last = z3ctx.int_const(("n" + std::to_string(defDepth - 1)).data());
+                args.push_back(role == value_role::entry ? z3ctx.int_val(0) : last + 1);
+            }
+        }
+        z3::sort_vector sorts(z3ctx);
+        for (unsigned i = 0; i < args.size(); i++) {
+            sorts.push_back(z3ctx.int_sort());
+        }
+        res = z3ctx.function(v->getName().data(), sorts, ret_sort)(args);
+    }
+    // the recurrences are solved on the terms as built
+    if (role != value_role::in_loop && role != value_role::initial) res = simplified(res);
+    memo.emplace(k, res);
+    return res;
+}
+
+static int def_depth(const Value* v, const LoopInfo& LI) {
+    const Instruction* inst = dyn_cast<Instruction>(v);
+    return inst ? LI.getLoopDepth(inst->getParent()) : 0;
+}
+
+z3::expr value_translator::def(const Value* v, const LoopInfo& LI) {
+    return term(v, value_role::def, def_depth(v, LI), 0);
+}
+
+z3::expr value_translator::use(const Use& u, const LoopInfo& LI, value_role role) {
+    const BasicBlock* userBB = cast<Instruction>(u.getUser())->getParent();
+    return term(u.get(), role, def_depth(u.get(), LI), LI.getLoopDepth(userBB));
+}
+
+z3::expr value_translator::entry(const PHINode* phi, const LoopInfo& LI) {
+    return term(phi, value_role::entry, def_depth(phi, LI), 0);
+}
+
+z3::expr value_translator::in_loop(const Value* v, const Loop* loop, bool initial) {
+    return term(v, initial ? value_role::initial : value_role::in_loop, 0, loop->getLoopDepth());
+}
+
+z3::expr value_translator::inlined(const Value* v, const Loop* loop) {
+    const Instruction* ins = dyn_cast<Instruction>(v);
+    // values from outside the body and the header phis are the variables of the recurrences;
+    // memory is not part of them, loaded values and addresses stay opaque
+    if (!ins || !loop->contains(ins->getParent()) || (isa<PHINode>(ins) && ins->getParent() == loop->getHeader())
+        || isa<LoadInst>(ins) || isa<GetElementPtrInst>(ins)) {
+        return in_loop(v, loop);
+    }
+    key k{v, value_role::inlined, (int)loop->getLoopDepth()};
+    auto found = memo.find(k);
+    if (found != memo.end()) return found->second;
+    z3::expr_vector operands(z3ctx);
+    for (const Use& u : ins->operands()) {
+        operands.push_back(in_loop(u.get(), loop));
+    }
+    z3::expr res(z3ctx);
+    if (!operator_term(ins, operands, res)) {
+        abortWithInfo(std::string("unimplemented: ") + v->getName().data());
+    }
+    memo.emplace(k, res);
+    return res;
+}
+
+namespace {
+
+typedef z3::expr (*term_builder)(const Instruction* inst, const z3::expr_vector& ops);
+
+z3::expr icmp_term(const Instruction* inst, const z3::expr_vector& ops) {
+    auto pred = cast<ICmpInst>(inst)->getPredicate();
+    if (ICmpInst::isLT(pred)) return ops[0] < ops[1];
+    if (ICmpInst::isLE(pred)) return ops[0] <= ops[1];
+    if (ICmpInst::isGT(pred)) return ops[0] > ops[1];
+    if (ICmpInst::isGE(pred)) return ops[0] >= ops[1];
+    return ops[0] == ops[1];
+}
+
+// byte offset of the address into the object the base points into
+z3::expr gep_term(const Instruction* inst, const z3::expr_vector& ops) {
+    const GetElementPtrInst* gep = cast<GetElementPtrInst>(inst);
+    const DataLayout& DL = inst->getModule()->getDataLayout();
+    z3::context& z3ctx = ops.ctx();
+    z3::expr offset = ops[0];
+    unsigned i = 1;
+    for (auto it = gep_type_begin(gep); it != gep_type_end(gep); it++, i++) {
+        if (StructType* st = it.getStructTypeOrNull()) {
+            unsigned field = cast<ConstantInt>(it.getOperand())->getZExtValue();
+            offset = offset + z3ctx.int_val((int64_t)DL.getStructLayout(st)->getElementOffset(field));
+        } else {
+            int64_t size = DL.getTypeAllocSize(it.getIndexedType()).getFixedSize();
+            offset = offset + ops[i] * z3ctx.int_val(size);
+        }
+    }
+    return offset;
+}
+
+// integers are unbounded, only the i1 ones are Bools
+z3::expr cast_term(const Instruction* inst, const z3::expr_vector& ops) {
+    z3::context& z3ctx = ops.ctx();
+    if (ops[0].is_bool()) {
+        return z3::ite(ops[0], z3ctx.int_val(inst->getOpcode() == Instruction::SExt ? -1 : 1), z3ctx.int_val(0));
+    }
+    if (inst->getType()->isIntegerTy(1)) return z3::mod(ops[0], 2) == 1;
+    return ops[0];
+}
+
+const std::map<unsigned, term_builder> term_builders = {
+    {Instruction::Add, [](const Instruction*, const z3::expr_vector& ops) { return ops[0] + ops[1]; }},
+    {Instruction::Sub, [](const Instruction*, const z3::expr_vector& ops) { return ops[0] - ops[1]; }},
+    {Instruction::Mul, [](const Instruction*, const z3::expr_vector& ops) { return ops[0] * ops[1]; }},
+    {Instruction::SRem, [](const Instruction*, const z3::expr_vector& ops) { return ops[0] % ops[1]; }},
+    {Instruction::URem, [](const Instruction*, const z3::expr_vector& ops) { return ops[0] % ops[1]; }},
+    {Instruction::ICmp, icmp_term},
+    {Instruction::Select, [](const Instruction*, const z3::expr_vector& ops) { return z3::ite(ops[0], ops[1], ops[2]); }},
+    {Instruction::GetElementPtr, gep_term},
+    {Instruction::BitCast, [](const Instruction*, const z3::expr_vector& ops) { return ops[0]; }},
+    {Instruction::SExt, cast_term},
+    {Instruction::ZExt, cast_term},
+    {Instruction::Trunc, cast_term},
+};
+
+}
+
+bool has_operator_term(const Instruction* inst) {
+    return term_builders.count(inst->getOpcode());
+}
+
+bool operator_term(const Instruction* inst, const z3::expr_vector& operands, z3::expr& res) {
+    auto builder = term_builders.find(inst->getOpcode());
+    if (builder == term_builders.end()) return false;
+    res = builder->second(inst, operands);
+    return true;
+}
+
+z3::expr value2z3(const Value* v, const Loop* loop, z3::context& z3ctx, bool initial) {
+    translation_scope translator(function_of(v), z3ctx);
+    return translator->in_loop(v, loop, initial);
+}
+
+z3::expr eliminate_tmp(const Value* v, const Loop* loop, z3::context& z3ctx) {
+    translation_scope translator(function_of(v), z3ctx);
+    return translator->inlined(v, loop);
+}
+
+z3::expr use2z3(const Use& u, const LoopInfo& LI, z3::context &z3ctx, bool from_latch, bool exit_cond) {
+    translation_scope translator(function_of(u.getUser()), z3ctx);
+    return translator->use(u, LI, exit_cond ? value_role::exit : from_latch ? value_role::from_latch : value_role::use);
+}
+
+z3::expr def2z3(const Value* v, const LoopInfo& LI, z3::context &z3ctx) {
+    translation_scope translator(function_of(v), z3ctx);
+    return translator->def(v, LI);
+}
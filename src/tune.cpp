@@ -0,0 +1,206 @@
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "z3++.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "solver_config.h"
+
+using namespace llvm;
+
+static cl::OptionCategory TuneCategory("c2z3-tune options");
+static cl::list<std::string> Inputs(cl::Positional, cl::desc("<SMT2 queries or directories of them (c2z3 dumps to tmp/)>"), cl::OneOrMore, cl::cat(TuneCategory));
+enum search_kind { search_grid, search_random };
+static cl::opt<search_kind> Search("search", cl::desc("How the parameter sets are chosen"),
+    cl::values(clEnumValN(search_grid, "grid", "Every combination (default)"),
+               clEnumValN(search_random, "random", "Random combinations, see -samples")),
+    cl::init(search_grid), cl::cat(TuneCategory));
+static cl::opt<unsigned> Samples("samples", cl::desc("Parameter sets tried by the random search"), cl::init(16), cl::cat(TuneCategory));
+static cl::opt<unsigned> Seed("seed", cl::desc("Seed of the random search"), cl::init(0), cl::cat(TuneCategory));
+static cl::opt<unsigned> Timeout("timeout", cl::desc("Milliseconds per query, as in c2z3"), cl::init(3000), cl::cat(TuneCategory));
+static cl::opt<std::string> Output("o", cl::desc("Write the best configuration here (load it with c2z3 -z3-config)"), cl::init("c2z3.cfg"), cl::cat(TuneCategory));
+static cl::opt<std::string> Log("log", cl::desc("Write every solve time to this CSV file"), cl::init(""), cl::cat(TuneCategory));
+
+namespace {
+
+struct tuned_param {
+    const char* name;
+    std::vector<std::string> values;    // Z3's default first
+};
+
+const std::vector<tuned_param> space = {
+    {"smt.auto_config", {"true", "false"}},
+    {"smt.mbqi", {"true", "false"}},
+    {"smt.arith.solver", {"6", "2"}},   // lra, simplex
+    {"smt.relevancy", {"2", "0"}},
+    {solver_config::preprocess_key, {"", "simplify", "ctx-solver-simplify"}},
+};
+
+struct score {
+    unsigned solved = 0;
+    double par2_ms = 0;     // unsolved queries count twice the timeout
+    bool consistent = true;
+    bool better_than(const score& other) const {
+        if (consistent != other.consistent) return consistent;
+        if (solved != other.solved) return solved > other.solved;
+        return par2_ms < other.par2_ms;
+    }
+};
+
+// the parameter set with value choice[i] for space[i]
+solver_config make_config(const std::vector<unsigned>& choice) {
+    solver_config cfg;
+    for (unsigned i = 0; i < space.size(); i++) {
+        cfg.set(space[i].name, space[i].values[choice[i]]);
+    }
+    return cfg;
+}
+
+std::vector<std::vector<unsigned>> candidates() {
+    std::vector<std::vector<unsigned>> res;
+    std::vector<unsigned> choice(space.size(), 0);
+    if (Search == search_grid) {
+        // counts through the choices like a mixed-radix number
+        while (true) {
+            res.push_back(choice);
+            unsigned i = 0;
+            for (; i < space.size(); i++) {
+                if (++choice[i] < space[i].values.size()) break;
+                choice[i] = 0;
+            }
+            if (i == space.size()) break;
+        }
+        return res;
+    }
+    // the defaults are always measured, as the baseline
+    std::set<std::vector<unsigned>> seen{choice};
+    res.push_back(choice);
+    size_t combinations = 1;
+    for (const tuned_param& p : space) {
+        combinations *= p.values.size();
+    }
+    std::mt19937 rng(Seed);
+    while (res.size() < std::min<size_t>(Samples, combinations)) {
+        for (unsigned i = 0; i < space.size(); i++) {
+            choice[i] = std::uniform_int_distribution<unsigned>(0, space[i].values.size() - 1)(rng);
+        }
+        if (seen.insert(choice).second) res.push_back(choice);
+    }
+    return res;
+}
+
+std::vector<std::string> collect_queries() {
+    std::vector<std::string> res;
+    for (const std::string& input : Inputs) {
+        if (!sys::fs::is_directory(input)) {
+            res.push_back(input);
+            continue;
+        }
+        std::error_code ec;
+        for (sys::fs::recursive_directory_iterator it(input, ec), end; it != end && !ec; it.increment(ec)) {
+            if (sys::path::extension(it->path()) == ".smt2") res.push_back(it->path());
+        }
+    }
+    std::sort(res.begin(), res.end());
+    return res;
+}
+
+// sat/unsat/unknown and the time it took; parameters are global, each query gets a fresh context
+z3::check_result solve(const solver_config& cfg, const std::string& path, double& ms) {
+    z3::reset_params();
+    cfg.install();
+    z3::context z3ctx;
+    z3::expr_vector query = z3ctx.parse_file(path.data());
+    z3::solver solver = cfg.make_solver(z3ctx);
+    z3::params p(z3ctx);
+    p.set(":timeout", (unsigned)Timeout);
+    solver.set(p);
+    solver.add(query);
+    auto start = std::chrono::steady_clock::now();
+    z3::check_result result = solver.check();
+    ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+const char* result_name(z3::check_result r) {
+    return r == z3::sat ? "sat" : r == z3::unsat ? "unsat" : "unknown";
+}
+
+}
+
+int main(int argc, char** argv) {
+    cl::HideUnrelatedOptions(TuneCategory);
+    cl::ParseCommandLineOptions(argc, argv, "c2z3-tune: search Z3 options for the queries c2z3 dumps\n");
+    std::vector<std::string> queries = collect_queries();
+    if (queries.empty()) {
+        errs() << "c2z3-tune: no queries found\n";
+        return 1;
+    }
+    std::ofstream log;
+    if (!Log.empty()) {
+        log.open(Log);
+        log << "config,query,result,ms\n";
+    }
+
+    // a definite answer contradicting another configuration disqualifies the configuration
+    std::map<std::string, z3::check_result> answers;
+    std::vector<std::vector<unsigned>> choices = candidates();
+    solver_config best;
+    score best_score;
+    for (unsigned c = 0; c < choices.size(); c++) {
+        solver_config cfg = make_config(choices[c]);
+        score s;
+        for (const std::string& path : queries) {
+            double ms = 0;
+            z3::check_result r = z3::unknown;
+            try {
+                r = solve(cfg, path, ms);
+            } catch (const z3::exception& e) {
+                errs() << path << ": " << e.msg() << "\n";
+                ms = Timeout;
+            }
+            if (log.is_open()) log << c << "," << path << "," << result_name(r) << "," << ms << "\n";
+            if (r == z3::unknown) {
+                s.par2_ms += 2.0 * Timeout;
+                continue;
+            }
+            s.solved++;
+            s.par2_ms += ms;
+            auto known = answers.emplace(path, r).first;
+            if (known->second != r) {
+                errs() << "c2z3-tune: configuration " << c << " answers " << result_name(r) << " on " << path << ", others " << result_name(known->second) << "\n";
+                s.consistent = false;
+            }
+        }
+        errs() << "[" << c + 1 << "/" << choices.size() << "] solved " << s.solved << "/" << queries.size() << ", PAR2 " << (unsigned)s.par2_ms << " ms:";
+        for (auto& param : cfg.params()) {
+            errs() << " " << param.first << "=" << param.second;
+        }
+        errs() << "\n";
+        if (c == 0 || s.better_than(best_score)) {
+            best = cfg;
+            best_score = s;
+        }
+    }
+    z3::reset_params();
+
+    std::ofstream out(Output);
+    out << "# c2z3-tune: solved " << best_score.solved << "/" << queries.size() << " queries, PAR2 " << (unsigned)best_score.par2_ms << " ms\n";
+    out << best.to_string();
+    if (!out) {
+        errs() << "c2z3-tune: cannot write " << Output << "\n";
+        return 1;
+    }
+    errs() << "best configuration written to " << Output << "\n";
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include "worker_pool.h"
+#include "memory_budget.h"
+#include <sys/wait.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <new>
+#include <stdexcept>
+
+static bool write_all(int fd, const std::string& s) {
+    size_t done = 0;
+    while (done < s.size()) {
+        ssize_t n = write(fd, s.data() + done, s.size() - done);
+        if (n < 0) return false;
+        done += n;
+    }
+    return true;
+}
+
+static bool read_line(int fd, std::string& line) {
+    line.clear();
+    char c;
+    while (read(fd, &c, 1) == 1) {
+        if (c == '\n') return true;
+        line.push_back(c);
+    }
+    return false;
+}
+
+worker_pool::worker_pool(unsigned size, rlim_t memory_mb, rlim_t cpu_seconds): size(size), memory_mb(memory_mb), cpu_seconds(cpu_seconds) {}
+
+void worker_pool::serve(int task_fd, int result_fd, const job_fn& job) {
+    if (memory_mb > 0) {
+        struct rlimit mem = {memory_mb << 20, memory_mb << 20};
+        setrlimit(RLIMIT_AS, &mem);
+    }
+    std::string line;
+    while (read_line(task_fd, line)) {
+        int task = std::atoi(line.c_str());
+        if (cpu_seconds > 0) {
+            // RLIMIT_CPU is cumulative, so the cap is relative to what this worker already used
+            struct rusage usage;
+            getrusage(RUSAGE_SELF, &usage);
+            rlim_t used = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + 1;
+            struct rlimit cpu = {used + cpu_seconds, used + cpu_seconds + 1};
+            setrlimit(RLIMIT_CPU, &cpu);
+        }
+        std::string payload;
+        bool exhausted = false;
+        try {
+            payload = job(task);
+        } catch (const std::bad_alloc&) {
+            exhausted = true;
+        } catch (const std::exception& e) {
+            // Z3 running into the address space cap
+            exhausted = z3_out_of_memory();
+            if (!exhausted) fprintf(stderr, "c2z3: worker: %s\n", e.what());
+            payload = "error";
+        } catch (...) {
+            exhausted = z3_out_of_memory();
+            payload = "error";
+        }
+        if (exhausted) {
+            // the heap may be in a bad state, let the coordinator start a fresh worker
+            write_all(result_fd, std::to_string(task) + " resource-out\n");
+            _exit(1);
+        }
+        if (!write_all(result_fd, std::to_string(task) + " " + payload + "\n")) break;
+    }
+    _exit(0);
+}
+
+bool worker_pool::spawn(worker& w, const job_fn& job) {
+    int task_pipe[2];
+    int result_pipe[2];
+    if (pipe(task_pipe) != 0) return false;
+    if (pipe(result_pipe) != 0) {
+        close(task_pipe[0]);
+        close(task_pipe[1]);
+        return false;
+    }
+    fflush(nullptr);
+    pid_t pid = fork();
+    if (pid < 0) return false;
+    if (pid == 0) {
+        close(task_pipe[1]);
+        close(result_pipe[0]);
+        for (auto& other : workers) {
+            if (other.pid > 0) {
+                close(other.task_fd);
+                close(other.result_fd);
+            }
+        }
+        serve(task_pipe[0], result_pipe[1], job);
+    }
+    close(task_pipe[0]);
+    close(result_pipe[1]);
+    w.pid = pid;
+    w.task_fd = task_pipe[1];
+    w.result_fd = result_pipe[0];
+    w.task = -1;
+    w.buffer.clear();
+    return true;
+}
+
+int worker_pool::reap(worker& w) {
+    close(w.task_fd);
+    close(w.result_fd);
+    int status = 0;
+    waitpid(w.pid, &status, 0);
+    w.pid = -1;
+    return status;
+}
+
+void worker_pool::run(int num_tasks, const job_fn& job, const result_fn& on_result) {
+    signal(SIGPIPE, SIG_IGN);
+    std::deque<int> pending;
+    for (int i = 0; i < num_tasks; i++) {
+        pending.push_back(i);
+    }
+    workers.assign(size, worker{-1, -1, -1, -1, ""});
+    for (auto& w : workers) {
+        if (!spawn(w, job)) throw std::runtime_error("cannot fork worker");
+    }
+    int remaining = num_tasks;
+    while (remaining > 0) {
+        std::vector<pollfd> fds;
+        std::vector<worker*> polled;
+        for (auto& w : workers) {
+            if (w.pid < 0) continue;
+            if (w.task < 0 && !pending.empty()) {
+                if (!write_all(w.task_fd, std::to_string(pending.front()) + "\n")) {
+                    // died while idle, nothing was lost
+                    reap(w);
+                    if (!spawn(w, job)) throw std::runtime_error("cannot fork worker");
+                    continue;
+                }
+                w.task = pending.front();
+                pending.pop_front();
+            }
+            if (w.task >= 0) {
+                fds.push_back(pollfd{w.result_fd, POLLIN, 0});
+                polled.push_back(&w);
+            }
+        }
+        if (fds.empty()) {
+            if (pending.empty()) break;
+            continue;
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0) continue;
+        for (size_t i = 0; i < fds.size(); i++) {
+            if (fds[i].revents == 0) continue;
+            worker& w = *polled[i];
+            char chunk[4096];
+            ssize_t n = read(w.result_fd, chunk, sizeof(chunk));
+            bool exiting = false;
+            if (n > 0) {
+                w.buffer.append(chunk, n);
+                size_t eol;
+                while ((eol = w.buffer.find('\n')) != std::string::npos) {
+                    std::string line = w.buffer.substr(0, eol);
+                    w.buffer.erase(0, eol + 1);
+                    size_t space = line.find(' ');
+                    std::string payload = space == std::string::npos ? "" : line.substr(space + 1);
+                    on_result(std::atoi(line.c_str()), payload);
+                    w.task = -1;
+                    remaining--;
+                    // the worker exits after reporting an exhausted job
+                    exiting = exiting || payload == "resource-out";
+                }
+                if (!exiting) continue;
+            }
+            // the worker is gone: its job was killed by a limit (SIGXCPU past the
+            // soft CPU cap, SIGKILL past the hard one or from the OOM killer) or crashed
+            int task = w.task;
+            int status = reap(w);
+            if (task >= 0) {
+                bool killed = WIFSIGNALED(status) && (WTERMSIG(status) == SIGXCPU || WTERMSIG(status) == SIGKILL);
+                on_result(task, killed ? "resource-out" : "error");
+                remaining--;
+            }
+            if (!pending.empty() && !spawn(w, job)) throw std::runtime_error("cannot fork worker");
+        }
+    }
+    for (auto& w : workers) {
+        if (w.pid > 0) reap(w);
+    }
+}
@@ -0,0 +1,50 @@
+; ModuleID = 'test/array.c'
+source_filename = "test/array.c"
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+; int main() {
+;     int a[10];
+;     for (int i = 0; i < 10; i++) a[i] = i;
+;     assert(a[3] == 3);
+;     assert(a[4] == 5);
+; }
+define dso_local i32 @main() #0 {
+  %1 = alloca i32, align 4
+  %2 = alloca [10 x i32], align 16
+  %3 = alloca i32, align 4
+  store i32 0, i32* %1, align 4
+  store i32 0, i32* %3, align 4
+  br label %4
+
+4:
+  %5 = load i32, i32* %3, align 4
+  %6 = icmp slt i32 %5, 10
+  br i1 %6, label %7, label %13
+
+7:
+  %8 = load i32, i32* %3, align 4
+  %9 = load i32, i32* %3, align 4
+  %10 = sext i32 %9 to i64
+  %11 = getelementptr inbounds [10 x i32], [10 x i32]* %2, i64 0, i64 %10
+  store i32 %8, i32* %11, align 4
+  %12 = add nsw i32 %9, 1
+  store i32 %12, i32* %3, align 4
+  br label %4
+
+13:
+  %14 = getelementptr inbounds [10 x i32], [10 x i32]* %2, i64 0, i64 3
+  %15 = load i32, i32* %14, align 4
+  %16 = icmp eq i32 %15, 3
+  call void @assert(i1 noundef zeroext %16)
+  %17 = getelementptr inbounds [10 x i32], [10 x i32]* %2, i64 0, i64 4
+  %18 = load i32, i32* %17, align 4
+  %19 = icmp eq i32 %18, 5
+  call void @assert(i1 noundef zeroext %19)
+  ret i32 0
+}
+
+declare void @assert(i1 noundef zeroext) #1
+
+attributes #0 = { noinline nounwind uwtable "frame-pointer"="all" }
+attributes #1 = { "frame-pointer"="all" }
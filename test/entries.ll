@@ -0,0 +1,31 @@
+; ModuleID = 'test/entries.c'
+source_filename = "test/entries.c"
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+; int foo() { int x = 2; assert(x + 1 == 4); return x; }
+define dso_local i32 @foo() #0 {
+  %1 = alloca i32, align 4
+  store i32 2, i32* %1, align 4
+  %2 = load i32, i32* %1, align 4
+  %3 = add nsw i32 %2, 1
+  %4 = icmp eq i32 %3, 4
+  call void @assert(i1 noundef zeroext %4)
+  %5 = load i32, i32* %1, align 4
+  ret i32 %5
+}
+
+; int main() { int y = 3; assert(y == 3); return 0; }
+define dso_local i32 @main() #0 {
+  %1 = alloca i32, align 4
+  store i32 3, i32* %1, align 4
+  %2 = load i32, i32* %1, align 4
+  %3 = icmp eq i32 %2, 3
+  call void @assert(i1 noundef zeroext %3)
+  ret i32 0
+}
+
+declare void @assert(i1 noundef zeroext) #1
+
+attributes #0 = { noinline nounwind uwtable "frame-pointer"="all" }
+attributes #1 = { "frame-pointer"="all" }
@@ -0,0 +1,44 @@
+; ModuleID = 'test/kinduction.c'
+source_filename = "test/kinduction.c"
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+; int main(int n) {
+;     int x = 0, y = 0;
+;     for (int i = 0; i < n; i++) {
+;         int d = x < i ? 1 : 2;
+;         x += d;
+;         y += d;
+;     }
+;     assert(x == y);
+; }
+; no closed form and no bound on the iterations, x == y holds by induction
+define dso_local i32 @main(i32 noundef %n) #0 {
+entry:
+  br label %header
+
+header:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %body ]
+  %x = phi i32 [ 0, %entry ], [ %x.next, %body ]
+  %y = phi i32 [ 0, %entry ], [ %y.next, %body ]
+  %cmp = icmp slt i32 %i, %n
+  br i1 %cmp, label %body, label %exit
+
+body:
+  %lt = icmp slt i32 %x, %i
+  %d = select i1 %lt, i32 1, i32 2
+  %x.next = add nsw i32 %x, %d
+  %y.next = add nsw i32 %y, %d
+  %i.next = add nsw i32 %i, 1
+  br label %header
+
+exit:
+  %ok = icmp eq i32 %x, %y
+  call void @assert(i1 noundef zeroext %ok)
+  ret i32 0
+}
+
+declare void @assert(i1 noundef zeroext) #1
+
+attributes #0 = { noinline nounwind uwtable "frame-pointer"="all" }
+attributes #1 = { "frame-pointer"="all" }
@@ -0,0 +1,32 @@
+; ModuleID = 'test/sdiv.c'
+source_filename = "test/sdiv.c"
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+; int main() { int x = 100; for (int i = 0; i < 10; i++) x = x / 2; assert(x >= 0); }
+; the encoder has no term for sdiv
+define dso_local i32 @main() #0 {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %body ]
+  %x = phi i32 [ 100, %entry ], [ %x.next, %body ]
+  %cmp = icmp slt i32 %i, 10
+  br i1 %cmp, label %body, label %exit
+
+body:
+  %x.next = sdiv i32 %x, 2
+  %i.next = add nsw i32 %i, 1
+  br label %loop
+
+exit:
+  %ok = icmp sge i32 %x, 0
+  call void @assert(i1 noundef zeroext %ok)
+  ret i32 0
+}
+
+declare void @assert(i1 noundef zeroext) #1
+
+attributes #0 = { noinline nounwind uwtable "frame-pointer"="all" }
+attributes #1 = { "frame-pointer"="all" }
@@ -0,0 +1,22 @@
+#!/bin/sh
+# usage: serve.sh <c2z3> <test dir>
+# c2z3 -serve answers an input it cannot encode with an error and goes on
+# serving: sdiv.ll fails, test.ll is checked after it
+c2z3=$1
+dir=$2
+socket=$PWD/serve-test.sock
+# a socket left by an earlier run would pass for the new daemon's
+rm -f "$socket"
+"$c2z3" -engine=bmc -serve="$socket" &
+server=$!
+trap 'kill $server 2>/dev/null' EXIT
+tries=0
+while [ ! -S "$socket" ] && [ $tries -lt 100 ]; do
+    sleep 0.1
+    tries=$((tries + 1))
+done
+if "$c2z3" -connect="$socket" "$dir/sdiv.ll"; then
+    echo "sdiv.ll was checked"
+    exit 1
+fi
+"$c2z3" -connect="$socket" "$dir/test.ll" 2>&1 | grep -x Correct
@@ -0,0 +1,13 @@
+; main's argument is named "a b", which no C source produces; the witness of
+; the violation carries the name, space included
+define dso_local i32 @main(i32 noundef %"a b") #0 {
+entry:
+  %ok = icmp ne i32 %"a b", 0
+  call void @assert(i1 noundef zeroext %ok)
+  ret i32 0
+}
+
+declare void @assert(i1 noundef zeroext) #1
+
+attributes #0 = { noinline nounwind uwtable "frame-pointer"="all" }
+attributes #1 = { "frame-pointer"="all" }
@@ -0,0 +1,20 @@
+#!/bin/sh
+# usage: worker-memory.sh <c2z3> <megabytes>
+# a worker whose address space cap Z3 runs into reports resource-out: the
+# input is a chain of 50000 additions, more than a few hundred megabytes let
+# Z3 build
+c2z3=$1
+input=$PWD/worker-memory.ll
+awk 'BEGIN {
+    print "declare void @assert(i1)"
+    print "define i32 @main(i32 %x) {"
+    print "entry:"
+    print "  %v0 = add i32 %x, 0"
+    for (i = 1; i < 50000; i++)
+        printf "  %%v%d = add i32 %%v%d, 1\n", i, i - 1
+    print "  %c = icmp sge i32 %v49999, %v0"
+    print "  call void @assert(i1 %c)"
+    print "  ret i32 0"
+    print "}"
+}' > "$input"
+"$c2z3" -workers=1 -worker-memory="$2" "$input"